@@ -0,0 +1,359 @@
+/* SPA Null Sink Control-Plane Benchmark */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file bench-control.c
+ * @brief Microbenchmarks for the null sink control-plane methods
+ *
+ * Devices hotplug constantly, so negotiation latency matters as much as
+ * the process path. This benchmark measures the spa_node methods PipeWire
+ * calls while (re)configuring a node, in nanoseconds per operation:
+ *
+ *   enum_params          Format enumeration without filter
+ *   enum_params_filter   Format enumeration intersected with a filter
+ *   set_param_format     Format parse and validation
+ *   port_use_buffers     Assigning MAX_BUFFERS buffers to the input port
+ *   command_start_pause  Start followed by Pause
+ *   pipelined_sync       Props set_param and enum_params, completed by sync
+ *
+ * Every benchmark runs a warmup phase, then collects a number of samples
+ * of a fixed number of operations each. The summary of the per-sample
+ * ns/op values is printed as one JSON line per benchmark:
+ *
+ * @code
+ * {"name":"enum_params","unit":"ns/op","samples":50,"ops_per_sample":10000,
+ *  "min":..,"median":..,"mean":..,"p99":..,"max":..,"stddev":..}
+ * @endcode
+ *
+ * Usage: null-bench-control [-w warmup] [-s samples] [-n ops-per-sample]
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <spa/node/node.h>
+#include <spa/pod/builder.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/param/props.h>
+
+#include "null.h"
+#include "bench-support.h"
+
+#define DEFAULT_WARMUP		1000
+#define DEFAULT_SAMPLES		50
+#define DEFAULT_OPS		10000
+
+struct bench_ctx {
+	struct spa_handle *handle;
+	struct spa_node *node;
+	struct spa_hook listener;
+	uint64_t n_results;
+	int last_seq;
+
+	struct spa_pod *format;
+	struct spa_pod *filter;
+	struct spa_pod *props;
+	uint8_t format_buffer[1024];
+	uint8_t filter_buffer[1024];
+	uint8_t props_buffer[256];
+
+	struct spa_buffer *buffers[MAX_BUFFERS];
+	struct spa_buffer buffer_mem[MAX_BUFFERS];
+	struct spa_data datas[MAX_BUFFERS];
+	struct spa_chunk chunks[MAX_BUFFERS];
+	float samples[MAX_BUFFERS][DEFAULT_FRAMES * 2];
+};
+
+typedef int (*bench_op_t)(struct bench_ctx *ctx);
+
+/*
+ * NODE EVENTS:
+ * ===========
+ * Results are consumed like a real client would, so the cost of the
+ * emission is part of the measurement.
+ */
+static void on_result(void *data, int seq, int res, uint32_t type, const void *result)
+{
+	struct bench_ctx *ctx = data;
+
+	ctx->n_results++;
+	ctx->last_seq = seq;
+}
+
+static const struct spa_node_events node_events = {
+	SPA_VERSION_NODE_EVENTS,
+	.result = on_result,
+};
+
+/*
+ * BENCHMARKED OPERATIONS:
+ * ======================
+ */
+
+static int op_enum_params(struct bench_ctx *ctx)
+{
+	return spa_node_enum_params(ctx->node, 0, SPA_PARAM_Format, 0, UINT32_MAX, NULL);
+}
+
+static int op_enum_params_filter(struct bench_ctx *ctx)
+{
+	return spa_node_enum_params(ctx->node, 0, SPA_PARAM_Format, 0, UINT32_MAX,
+				    ctx->filter);
+}
+
+static int op_set_param_format(struct bench_ctx *ctx)
+{
+	return spa_node_set_param(ctx->node, SPA_PARAM_Format, 0, ctx->format);
+}
+
+static int op_port_use_buffers(struct bench_ctx *ctx)
+{
+	return spa_node_port_use_buffers(ctx->node, SPA_DIRECTION_INPUT, 0, 0,
+					 ctx->buffers, MAX_BUFFERS);
+}
+
+static int op_command_start_pause(struct bench_ctx *ctx)
+{
+	int res;
+
+	if ((res = spa_node_send_command(ctx->node,
+			&SPA_NODE_COMMAND_INIT(SPA_NODE_COMMAND_Start))) < 0)
+		return res;
+	return spa_node_send_command(ctx->node,
+			&SPA_NODE_COMMAND_INIT(SPA_NODE_COMMAND_Pause));
+}
+
+static int op_pipelined_sync(struct bench_ctx *ctx)
+{
+	int res;
+
+	if ((res = spa_node_set_param(ctx->node, SPA_PARAM_Props, 0, ctx->props)) < 0 ||
+	    (res = spa_node_enum_params(ctx->node, 1, SPA_PARAM_Props, 0, 1, NULL)) < 0 ||
+	    (res = spa_node_sync(ctx->node, 2)) < 0)
+		return res;
+
+	/* The sync result is the last one of the batch */
+	return ctx->last_seq == 2 ? 0 : -EIO;
+}
+
+/*
+ * SETUP:
+ * =====
+ */
+
+static void setup_pods(struct bench_ctx *ctx)
+{
+	struct spa_pod_builder b;
+	struct spa_pod_frame f[2];
+
+	spa_pod_builder_init(&b, ctx->format_buffer, sizeof(ctx->format_buffer));
+	ctx->format = spa_format_audio_raw_build(&b, SPA_PARAM_Format,
+		&SPA_AUDIO_INFO_RAW_INIT(
+			.format = SPA_AUDIO_FORMAT_F32P,
+			.channels = 2,
+			.rate = 48000));
+
+	spa_pod_builder_init(&b, ctx->filter_buffer, sizeof(ctx->filter_buffer));
+	ctx->filter = spa_pod_builder_add_object(&b,
+		SPA_TYPE_OBJECT_Format, SPA_PARAM_Format,
+		SPA_FORMAT_mediaType,      SPA_POD_Id(SPA_MEDIA_TYPE_audio),
+		SPA_FORMAT_mediaSubtype,   SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
+		SPA_FORMAT_AUDIO_format,   SPA_POD_CHOICE_ENUM_Id(3,
+						SPA_AUDIO_FORMAT_F32P,
+						SPA_AUDIO_FORMAT_F32P,
+						SPA_AUDIO_FORMAT_S16),
+		SPA_FORMAT_AUDIO_rate,     SPA_POD_CHOICE_RANGE_Int(48000, 8000, 192000));
+
+	spa_pod_builder_init(&b, ctx->props_buffer, sizeof(ctx->props_buffer));
+	spa_pod_builder_push_object(&b, &f[0], SPA_TYPE_OBJECT_Props, SPA_PARAM_Props);
+	spa_pod_builder_prop(&b, SPA_PROP_params, 0);
+	spa_pod_builder_push_struct(&b, &f[1]);
+	spa_pod_builder_string(&b, NULL_KEY_LATENCY);
+	spa_pod_builder_string(&b, "256/48000");
+	spa_pod_builder_pop(&b, &f[1]);
+	ctx->props = spa_pod_builder_pop(&b, &f[0]);
+}
+
+static void setup_buffers(struct bench_ctx *ctx)
+{
+	uint32_t i;
+
+	for (i = 0; i < MAX_BUFFERS; i++) {
+		ctx->chunks[i] = (struct spa_chunk) {
+			.size = sizeof(ctx->samples[i]),
+		};
+		ctx->datas[i] = (struct spa_data) {
+			.type = SPA_DATA_MemPtr,
+			.maxsize = sizeof(ctx->samples[i]),
+			.data = ctx->samples[i],
+			.chunk = &ctx->chunks[i],
+		};
+		ctx->buffer_mem[i] = (struct spa_buffer) {
+			.n_datas = 1,
+			.datas = &ctx->datas[i],
+		};
+		ctx->buffers[i] = &ctx->buffer_mem[i];
+	}
+}
+
+static int setup_node(struct bench_ctx *ctx)
+{
+	const struct spa_handle_factory *factory = &spa_null_sink_factory;
+	void *iface;
+	int res;
+
+	ctx->handle = calloc(1, spa_handle_factory_get_size(factory, NULL));
+	if (ctx->handle == NULL)
+		return -errno;
+
+	if ((res = spa_handle_factory_init(factory, ctx->handle, NULL,
+			bench_support, SPA_N_ELEMENTS(bench_support))) < 0)
+		return res;
+
+	if ((res = spa_handle_get_interface(ctx->handle, SPA_TYPE_INTERFACE_Node, &iface)) < 0)
+		return res;
+
+	ctx->node = iface;
+	spa_node_add_listener(ctx->node, &ctx->listener, &node_events, ctx);
+
+	return 0;
+}
+
+static void teardown_node(struct bench_ctx *ctx)
+{
+	spa_hook_remove(&ctx->listener);
+	spa_handle_clear(ctx->handle);
+	free(ctx->handle);
+}
+
+/*
+ * MEASUREMENT LOOP:
+ * ================
+ */
+
+struct bench_params {
+	uint32_t warmup;
+	uint32_t samples;
+	uint32_t ops;
+};
+
+static int run_bench(struct bench_ctx *ctx, const struct bench_params *p,
+                     const char *name, bench_op_t op)
+{
+	struct bench_summary sum;
+	double *samples;
+	uint32_t i, j;
+	int res;
+
+	/* Sanity check - a failing op would only measure the error path */
+	if ((res = op(ctx)) < 0) {
+		fprintf(stderr, "%s: failed: %s\n", name, spa_strerror(res));
+		return res;
+	}
+
+	samples = calloc(p->samples, sizeof(double));
+	if (samples == NULL)
+		return -errno;
+
+	for (i = 0; i < p->warmup; i++)
+		op(ctx);
+
+	for (i = 0; i < p->samples; i++) {
+		uint64_t t0 = bench_now();
+
+		for (j = 0; j < p->ops; j++)
+			op(ctx);
+
+		samples[i] = (double) (bench_now() - t0) / p->ops;
+	}
+
+	bench_summarize(samples, p->samples, &sum);
+	bench_print_json(name, "ns/op", p->samples, p->ops, &sum);
+
+	free(samples);
+	return 0;
+}
+
+static void show_help(const char *name)
+{
+	fprintf(stderr, "%s [options]\n"
+		"  -w, --warmup N    warmup operations per benchmark (default %d)\n"
+		"  -s, --samples N   samples per benchmark (default %d)\n"
+		"  -n, --ops N       operations per sample (default %d)\n"
+		"  -h, --help        show this help\n",
+		name, DEFAULT_WARMUP, DEFAULT_SAMPLES, DEFAULT_OPS);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "warmup",  required_argument, NULL, 'w' },
+		{ "samples", required_argument, NULL, 's' },
+		{ "ops",     required_argument, NULL, 'n' },
+		{ "help",    no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	struct bench_params p = {
+		.warmup = DEFAULT_WARMUP,
+		.samples = DEFAULT_SAMPLES,
+		.ops = DEFAULT_OPS,
+	};
+	struct bench_ctx *ctx;
+	int c, res;
+
+	while ((c = getopt_long(argc, argv, "w:s:n:h", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'w':
+			p.warmup = atoi(optarg);
+			break;
+		case 's':
+			p.samples = atoi(optarg);
+			break;
+		case 'n':
+			p.ops = atoi(optarg);
+			break;
+		case 'h':
+			show_help(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			show_help(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (p.samples == 0 || p.ops == 0) {
+		show_help(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL)
+		return EXIT_FAILURE;
+
+	setup_pods(ctx);
+	setup_buffers(ctx);
+
+	if ((res = setup_node(ctx)) < 0) {
+		fprintf(stderr, "can't create null sink: %s\n", spa_strerror(res));
+		return EXIT_FAILURE;
+	}
+
+	if ((res = run_bench(ctx, &p, "enum_params", op_enum_params)) < 0 ||
+	    (res = run_bench(ctx, &p, "enum_params_filter", op_enum_params_filter)) < 0 ||
+	    (res = run_bench(ctx, &p, "set_param_format", op_set_param_format)) < 0 ||
+	    (res = run_bench(ctx, &p, "port_use_buffers", op_port_use_buffers)) < 0 ||
+	    (res = run_bench(ctx, &p, "command_start_pause", op_command_start_pause)) < 0 ||
+	    (res = run_bench(ctx, &p, "pipelined_sync", op_pipelined_sync)) < 0)
+		goto done;
+
+	fprintf(stderr, "%" PRIu64 " results emitted\n", ctx->n_results);
+done:
+	teardown_node(ctx);
+	free(ctx);
+
+	return res < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,256 @@
+/* SPA Null Sink Handle Scaling Benchmark */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file bench-handles.c
+ * @brief Stress benchmark creating and destroying large numbers of null sinks
+ *
+ * Null sinks are created and torn down by the thousand, so the per-handle
+ * footprint and the cost of impl_get_size/impl_init/impl_clear matter.
+ * This benchmark drives spa_null_sink_factory through the same factory
+ * calls PipeWire uses, for N handles at once (100000 by default):
+ *
+ *   1. create:   calloc(get_size) + spa_handle_factory_init()
+ *   2. start:    set_param(Format) + Start on every handle
+ *   3. stop:     Pause on every handle
+ *   4. teardown: spa_handle_clear() + free()
+ *
+ * It prints, one JSON line each:
+ *
+ *   handle_size       impl_get_size() and sizeof(struct null_state)
+ *   rss_per_handle    resident memory growth divided by N
+ *   create/start/stop/teardown  per-handle ns summaries
+ *
+ * REGRESSION GUARD:
+ * ================
+ * The run fails when impl_get_size() exceeds --max-size (default
+ * NULL_BENCH_MAX_HANDLE_SIZE) or the median create time exceeds
+ * --max-create-ns (disabled by default, since it is machine dependent).
+ *
+ * Usage: null-bench-handles [-n handles] [--max-size B] [--max-create-ns N]
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <spa/node/node.h>
+#include <spa/pod/builder.h>
+#include <spa/param/audio/format-utils.h>
+
+#include "null.h"
+#include "bench-support.h"
+
+#define DEFAULT_HANDLES			100000
+
+/** Budget for impl_get_size(), raise deliberately when state grows */
+#define NULL_BENCH_MAX_HANDLE_SIZE	16384
+
+struct handle_entry {
+	struct spa_handle *handle;
+	struct spa_node *node;
+};
+
+/** Resident set size in bytes, from /proc/self/statm */
+static uint64_t get_rss(void)
+{
+	unsigned long size, resident = 0;
+	FILE *f;
+
+	if ((f = fopen("/proc/self/statm", "r")) == NULL)
+		return 0;
+	if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(f);
+
+	return (uint64_t) resident * sysconf(_SC_PAGESIZE);
+}
+
+static void print_value(const char *name, const char *unit, double value)
+{
+	printf("{\"name\":\"%s\",\"unit\":\"%s\",\"value\":%.1f}\n", name, unit, value);
+	fflush(stdout);
+}
+
+static void print_phase(const char *name, double *samples, uint32_t n,
+                        struct bench_summary *sum)
+{
+	bench_summarize(samples, n, sum);
+	bench_print_json(name, "ns/handle", n, 1, sum);
+}
+
+static void show_help(const char *name)
+{
+	fprintf(stderr, "%s [options]\n"
+		"  -n, --handles N          number of handles (default %d)\n"
+		"  -m, --max-size B         fail if handle size exceeds B bytes (default %d)\n"
+		"  -c, --max-create-ns N    fail if median create time exceeds N ns\n"
+		"  -h, --help               show this help\n",
+		name, DEFAULT_HANDLES, NULL_BENCH_MAX_HANDLE_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "handles",       required_argument, NULL, 'n' },
+		{ "max-size",      required_argument, NULL, 'm' },
+		{ "max-create-ns", required_argument, NULL, 'c' },
+		{ "help",          no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	const struct spa_handle_factory *factory = &spa_null_sink_factory;
+	uint32_t i, n_handles = DEFAULT_HANDLES;
+	size_t max_size = NULL_BENCH_MAX_HANDLE_SIZE, size;
+	double max_create_ns = 0.0;
+	struct handle_entry *handles;
+	struct bench_summary create_sum, sum;
+	double *samples;
+	uint8_t buffer[1024];
+	struct spa_pod_builder b;
+	struct spa_pod *format;
+	uint64_t rss_before, rss_after, t0;
+	int c, res = 0;
+
+	while ((c = getopt_long(argc, argv, "n:m:c:h", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'n':
+			n_handles = atoi(optarg);
+			break;
+		case 'm':
+			max_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			max_create_ns = atof(optarg);
+			break;
+		case 'h':
+			show_help(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			show_help(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (n_handles == 0) {
+		show_help(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	handles = calloc(n_handles, sizeof(*handles));
+	samples = calloc(n_handles, sizeof(double));
+	if (handles == NULL || samples == NULL)
+		return EXIT_FAILURE;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	format = spa_format_audio_raw_build(&b, SPA_PARAM_Format,
+		&SPA_AUDIO_INFO_RAW_INIT(
+			.format = SPA_AUDIO_FORMAT_F32P,
+			.channels = 2,
+			.rate = 48000));
+
+	size = spa_handle_factory_get_size(factory, NULL);
+	printf("{\"name\":\"handle_size\",\"unit\":\"bytes\",\"get_size\":%zu,"
+	       "\"sizeof_null_state\":%zu,\"budget\":%zu}\n",
+	       size, sizeof(struct null_state), max_size);
+
+	/*
+	 * CREATE:
+	 * ======
+	 */
+	rss_before = get_rss();
+	for (i = 0; i < n_handles; i++) {
+		void *iface;
+
+		t0 = bench_now();
+		handles[i].handle = calloc(1, spa_handle_factory_get_size(factory, NULL));
+		if (handles[i].handle == NULL) {
+			res = -errno;
+			break;
+		}
+		if ((res = spa_handle_factory_init(factory, handles[i].handle, NULL,
+				bench_support, SPA_N_ELEMENTS(bench_support))) < 0 ||
+		    (res = spa_handle_get_interface(handles[i].handle,
+				SPA_TYPE_INTERFACE_Node, &iface)) < 0) {
+			free(handles[i].handle);
+			handles[i].handle = NULL;
+			break;
+		}
+		handles[i].node = iface;
+		samples[i] = bench_now() - t0;
+	}
+	if (res < 0) {
+		fprintf(stderr, "can't create handle %u: %s\n", i, spa_strerror(res));
+		n_handles = i;
+		goto teardown;
+	}
+	rss_after = get_rss();
+
+	print_value("rss_per_handle", "bytes",
+		    (double) (rss_after - rss_before) / n_handles);
+	print_phase("create", samples, n_handles, &create_sum);
+
+	/*
+	 * START:
+	 * =====
+	 */
+	for (i = 0; i < n_handles; i++) {
+		t0 = bench_now();
+		spa_node_set_param(handles[i].node, SPA_PARAM_Format, 0, format);
+		spa_node_send_command(handles[i].node,
+				&SPA_NODE_COMMAND_INIT(SPA_NODE_COMMAND_Start));
+		samples[i] = bench_now() - t0;
+	}
+	print_phase("start", samples, n_handles, &sum);
+
+	/*
+	 * STOP:
+	 * ====
+	 */
+	for (i = 0; i < n_handles; i++) {
+		t0 = bench_now();
+		spa_node_send_command(handles[i].node,
+				&SPA_NODE_COMMAND_INIT(SPA_NODE_COMMAND_Pause));
+		samples[i] = bench_now() - t0;
+	}
+	print_phase("stop", samples, n_handles, &sum);
+
+teardown:
+	/*
+	 * TEARDOWN:
+	 * ========
+	 */
+	for (i = 0; i < n_handles; i++) {
+		t0 = bench_now();
+		spa_handle_clear(handles[i].handle);
+		free(handles[i].handle);
+		samples[i] = bench_now() - t0;
+	}
+	if (res < 0)
+		goto done;
+
+	print_phase("teardown", samples, n_handles, &sum);
+
+	/*
+	 * REGRESSION GUARD:
+	 * ================
+	 */
+	if (size > max_size) {
+		fprintf(stderr, "handle size %zu exceeds budget of %zu bytes\n",
+			size, max_size);
+		res = -EFBIG;
+	}
+	if (max_create_ns > 0.0 && create_sum.median > max_create_ns) {
+		fprintf(stderr, "median create time %.1f ns exceeds budget of %.1f ns\n",
+			create_sum.median, max_create_ns);
+		res = -ETIME;
+	}
+done:
+	free(samples);
+	free(handles);
+
+	return res < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+/* SPA Null Plugin Benchmark Support */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file bench-support.h
+ * @brief Minimal SPA support interfaces and statistics for null benchmarks
+ *
+ * The benchmarks drive the null sink through its public factory and
+ * spa_node interface, exactly like PipeWire does, but without a running
+ * daemon. This header provides what impl_init() needs from the host:
+ *
+ * - A spa_log that is disabled (level NONE), so logging costs only the
+ *   level check, as on a production system
+ * - A spa_system that only implements clock_gettime()
+ *
+ * and the measurement helpers shared by all benchmarks:
+ *
+ * - bench_now(): monotonic time in nanoseconds
+ * - bench_summary: min/median/mean/p99/stddev over a set of samples
+ * - bench_print_json(): one JSON object per line, stable key order, so
+ *   two runs can be compared with diff or jq in regression jobs
+ */
+
+#ifndef NULL_BENCH_SUPPORT_H
+#define NULL_BENCH_SUPPORT_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <spa/support/log.h>
+#include <spa/support/plugin.h>
+#include <spa/support/system.h>
+
+/*
+ * STUB SUPPORT INTERFACES:
+ * =======================
+ */
+
+static const struct spa_log_methods bench_log_methods = {
+	SPA_VERSION_LOG_METHODS,
+};
+
+static struct spa_log bench_log = {
+	.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_Log, SPA_VERSION_LOG,
+				    &bench_log_methods, NULL),
+	.level = SPA_LOG_LEVEL_NONE,
+};
+
+static int bench_clock_gettime(void *object, int clockid, struct timespec *value)
+{
+	return clock_gettime(clockid, value);
+}
+
+static const struct spa_system_methods bench_system_methods = {
+	SPA_VERSION_SYSTEM_METHODS,
+	.clock_gettime = bench_clock_gettime,
+};
+
+static struct spa_system bench_system = {
+	.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_System, SPA_VERSION_SYSTEM,
+				    &bench_system_methods, NULL),
+};
+
+static const struct spa_support bench_support[] = {
+	SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_Log, &bench_log),
+	SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_System, &bench_system),
+};
+
+/*
+ * MEASUREMENT HELPERS:
+ * ===================
+ */
+
+/** Monotonic time in nanoseconds */
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+/** Statistical summary of a set of samples */
+struct bench_summary {
+	double min;
+	double median;
+	double mean;
+	double p99;
+	double max;
+	double stddev;
+};
+
+static int bench_cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Summarize @p n samples
+ *
+ * The samples are sorted in place.
+ */
+static inline void bench_summarize(double *samples, uint32_t n,
+                                   struct bench_summary *sum)
+{
+	double total = 0.0, var = 0.0;
+	uint32_t i;
+
+	qsort(samples, n, sizeof(double), bench_cmp_double);
+
+	for (i = 0; i < n; i++)
+		total += samples[i];
+	sum->mean = total / n;
+
+	for (i = 0; i < n; i++)
+		var += (samples[i] - sum->mean) * (samples[i] - sum->mean);
+	sum->stddev = n > 1 ? sqrt(var / (n - 1)) : 0.0;
+
+	sum->min = samples[0];
+	sum->max = samples[n - 1];
+	sum->median = (n & 1) ? samples[n / 2] :
+		(samples[n / 2 - 1] + samples[n / 2]) / 2.0;
+	sum->p99 = samples[SPA_MIN(n - 1, (uint32_t) ceil(n * 0.99) - 1)];
+}
+
+/**
+ * @brief Print one benchmark result as a single JSON line
+ *
+ * @param name    Benchmark name
+ * @param unit    Unit of the summary values
+ * @param samples Number of samples in the summary
+ * @param ops     Operations per sample
+ * @param sum     Summary to print
+ */
+static inline void bench_print_json(const char *name, const char *unit,
+                                    uint32_t samples, uint32_t ops,
+                                    const struct bench_summary *sum)
+{
+	printf("{\"name\":\"%s\",\"unit\":\"%s\",\"samples\":%u,\"ops_per_sample\":%u,"
+	       "\"min\":%.1f,\"median\":%.1f,\"mean\":%.1f,\"p99\":%.1f,"
+	       "\"max\":%.1f,\"stddev\":%.1f}\n",
+	       name, unit, samples, ops,
+	       sum->min, sum->median, sum->mean, sum->p99, sum->max, sum->stddev);
+	fflush(stdout);
+}
+
+#endif /* NULL_BENCH_SUPPORT_H */
@@ -0,0 +1,64 @@
+/* SPA Null Control Sink Format Handling */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-control.c
+ * @brief SPA Null Sink - application/control (MIDI, OSC, properties) negotiation
+ *
+ * The api.null.control-sink factory creates a null sink that accepts
+ * control streams: buffers holding one spa_pod_sequence of timed control
+ * events, as produced by MIDI bridges and routing graphs.
+ *
+ * Instead of only dropping the buffer, the control sink walks the sequence
+ * in place (no copy) and keeps cheap per-event statistics, so it can serve
+ * as a terminal that also reports event throughput and scheduling skew:
+ *
+ * - events per SPA_CONTROL_* type
+ * - MIDI channel messages per status class (note off ... pitch bend, system)
+ * - min/max/average event offset within the quantum
+ * - events placed at or past the end of the quantum (late)
+ * - events whose offset goes backwards within a sequence (unordered)
+ *
+ * The walk itself runs in the control process kernel in null-process.c.
+ */
+
+#include <errno.h>
+
+#include <spa/pod/builder.h>
+#include <spa/param/format-utils.h>
+
+#include "null.h"
+
+int null_control_enum_format(struct null_state *state, uint32_t id, uint32_t index,
+                             struct spa_pod_builder *b, struct spa_pod **param)
+{
+	if (index > 0)
+		return 0;
+
+	*param = spa_pod_builder_add_object(b,
+		SPA_TYPE_OBJECT_Format, id,
+		SPA_FORMAT_mediaType,    SPA_POD_Id(SPA_MEDIA_TYPE_application),
+		SPA_FORMAT_mediaSubtype, SPA_POD_Id(SPA_MEDIA_SUBTYPE_control));
+	return 1;
+}
+
+int null_control_parse_format(struct null_state *state, const struct spa_pod *param)
+{
+	uint32_t media_type, media_subtype;
+	int res;
+
+	if ((res = spa_format_parse(param, &media_type, &media_subtype)) < 0)
+		return res;
+
+	if (media_type != SPA_MEDIA_TYPE_application ||
+	    media_subtype != SPA_MEDIA_SUBTYPE_control) {
+		spa_log_error(state->log, "null-sink %p: unsupported media type %d/%d",
+			     state, media_type, media_subtype);
+		return -EINVAL;
+	}
+
+	spa_log_info(state->log, "null-sink %p: control format set", state);
+
+	return 0;
+}
@@ -0,0 +1,362 @@
+/* SPA Null Sink Encoded Audio Handling */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-encoded.c
+ * @brief SPA Null Sink - Compressed and IEC958 passthrough audio
+ *
+ * Besides audio/raw, the audio null sink accepts encoded streams so that
+ * encoder pipelines can be throughput-tested against a terminal that
+ * never decodes:
+ *
+ *   audio/iec958   IEC 61937 bursts (AC3, E-AC3, DTS, TrueHD, ...) or PCM
+ *   audio/aac      ADTS framed or raw access units
+ *   audio/mp3      MPEG-1/2 layer II and III frames
+ *   audio/opus     one Opus packet per buffer
+ *
+ * ENCODED FRAME COUNTING:
+ * ======================
+ * Only the frame headers are read, just enough to find the frame length
+ * and the number of decoded samples it represents. Frames are counted in
+ * frame_count, buffer bytes in byte_count, codec frame bytes in
+ * encoded_payload and decoded samples in encoded_samples, so the average
+ * bitrate is
+ *
+ *   encoded_payload * 8 * encoded_rate / encoded_samples
+ *
+ * For IEC 61937 the payload is the Pd length of each burst: byte_count
+ * also holds the zero stuffing that pads a burst to its repetition
+ * period, which would report the IEC958 link rate instead of the codec
+ * bitrate.
+ *
+ * A frame that continues into the next buffer is skipped there through
+ * encoded_skip instead of being reassembled.
+ */
+
+#include <errno.h>
+
+#include <spa/debug/types.h>
+#include <spa/param/format-types.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/param/audio/iec958.h>
+#include <spa/pod/builder.h>
+#include <spa/pod/parser.h>
+
+#include "null.h"
+
+/** Encoded subtypes accepted by the audio null sink, in enumeration order */
+static const uint32_t encoded_subtypes[] = {
+	SPA_MEDIA_SUBTYPE_iec958,
+	SPA_MEDIA_SUBTYPE_aac,
+	SPA_MEDIA_SUBTYPE_mp3,
+	SPA_MEDIA_SUBTYPE_opus,
+};
+
+int null_encoded_enum_format(struct null_state *state, uint32_t id, uint32_t index,
+                             struct spa_pod_builder *b, struct spa_pod **param)
+{
+	struct spa_pod_frame f;
+	uint32_t subtype;
+
+	if (index >= SPA_N_ELEMENTS(encoded_subtypes))
+		return 0;
+
+	subtype = encoded_subtypes[index];
+
+	spa_pod_builder_push_object(b, &f, SPA_TYPE_OBJECT_Format, id);
+	spa_pod_builder_add(b,
+		SPA_FORMAT_mediaType,      SPA_POD_Id(SPA_MEDIA_TYPE_audio),
+		SPA_FORMAT_mediaSubtype,   SPA_POD_Id(subtype),
+		SPA_FORMAT_AUDIO_rate,     SPA_POD_CHOICE_RANGE_Int(48000, 8000, 192000),
+		SPA_FORMAT_AUDIO_channels, SPA_POD_CHOICE_RANGE_Int(2, 1, 64),
+		0);
+
+	if (subtype == SPA_MEDIA_SUBTYPE_iec958) {
+		spa_pod_builder_add(b,
+			SPA_FORMAT_AUDIO_iec958Codec, SPA_POD_CHOICE_ENUM_Id(8,
+				SPA_AUDIO_IEC958_CODEC_AC3,
+				SPA_AUDIO_IEC958_CODEC_PCM,
+				SPA_AUDIO_IEC958_CODEC_AC3,
+				SPA_AUDIO_IEC958_CODEC_DTS,
+				SPA_AUDIO_IEC958_CODEC_MPEG,
+				SPA_AUDIO_IEC958_CODEC_MPEG2_AAC,
+				SPA_AUDIO_IEC958_CODEC_EAC3,
+				SPA_AUDIO_IEC958_CODEC_TRUEHD),
+			0);
+	}
+
+	*param = spa_pod_builder_pop(b, &f);
+	return 1;
+}
+
+int null_encoded_build_format(struct null_state *state, uint32_t id,
+                              struct spa_pod_builder *b, struct spa_pod **param)
+{
+	struct spa_pod_frame f;
+	uint32_t subtype = state->current_format.media_subtype;
+
+	spa_pod_builder_push_object(b, &f, SPA_TYPE_OBJECT_Format, id);
+	spa_pod_builder_add(b,
+		SPA_FORMAT_mediaType,      SPA_POD_Id(SPA_MEDIA_TYPE_audio),
+		SPA_FORMAT_mediaSubtype,   SPA_POD_Id(subtype),
+		SPA_FORMAT_AUDIO_rate,     SPA_POD_Int(state->encoded_rate),
+		SPA_FORMAT_AUDIO_channels, SPA_POD_Int(state->encoded_channels),
+		0);
+
+	if (subtype == SPA_MEDIA_SUBTYPE_iec958)
+		spa_pod_builder_add(b,
+			SPA_FORMAT_AUDIO_iec958Codec, SPA_POD_Id(state->encoded_codec),
+			0);
+
+	*param = spa_pod_builder_pop(b, &f);
+	return 1;
+}
+
+int null_encoded_parse_format(struct null_state *state, const struct spa_pod *param,
+                              struct spa_audio_info *info)
+{
+	uint32_t i, codec = SPA_AUDIO_IEC958_CODEC_UNKNOWN;
+	int32_t rate = 0, channels = 0;
+	int res;
+
+	for (i = 0; i < SPA_N_ELEMENTS(encoded_subtypes); i++) {
+		if (encoded_subtypes[i] == info->media_subtype)
+			break;
+	}
+	if (info->media_type != SPA_MEDIA_TYPE_audio || i == SPA_N_ELEMENTS(encoded_subtypes)) {
+		spa_log_error(state->log, "null-sink %p: unsupported media type %d/%d",
+			     state, info->media_type, info->media_subtype);
+		return -EINVAL;
+	}
+
+	/* Only what is needed for bitrate statistics, no codec config */
+	if ((res = spa_pod_parse_object(param,
+			SPA_TYPE_OBJECT_Format, NULL,
+			SPA_FORMAT_AUDIO_rate,        SPA_POD_OPT_Int(&rate),
+			SPA_FORMAT_AUDIO_channels,    SPA_POD_OPT_Int(&channels),
+			SPA_FORMAT_AUDIO_iec958Codec, SPA_POD_OPT_Id(&codec))) < 0) {
+		spa_log_error(state->log, "null-sink %p: failed to parse encoded format: %s",
+			     state, spa_strerror(res));
+		return res;
+	}
+
+	/* Opus always decodes at 48kHz, whatever the stream advertises */
+	if (info->media_subtype == SPA_MEDIA_SUBTYPE_opus || rate <= 0)
+		rate = 48000;
+
+	state->encoded_rate = rate;
+	state->encoded_channels = channels > 0 ? channels : 2;
+	state->encoded_codec = codec;
+
+	spa_log_info(state->log, "null-sink %p: encoded format %s, %d Hz, %d channels",
+		    state, spa_debug_type_find_name(spa_type_media_subtype, info->media_subtype),
+		    rate, state->encoded_channels);
+
+	return 0;
+}
+
+/*
+ * FRAME PARSERS:
+ * =============
+ * Real-time context: no logging, no allocation. Each parser returns the
+ * number of frames found in data[0..size), adds the decoded samples to
+ * encoded_samples and the frame bytes to encoded_payload, and sets
+ * encoded_skip when the last frame continues past the end of the buffer.
+ */
+
+static inline uint32_t iec958_burst_samples(uint8_t data_type)
+{
+	/* IEC 61937-2 data types, low 5 bits of Pc */
+	switch (data_type & 0x1f) {
+	case 0x01: return 1536;         /* AC-3 */
+	case 0x04: return 384;          /* MPEG-1 layer 1 */
+	case 0x05: return 1152;         /* MPEG-1 layer 2/3, MPEG-2 */
+	case 0x07: return 1024;         /* MPEG-2 AAC */
+	case 0x0b: return 512;          /* DTS type I */
+	case 0x0c: return 1024;         /* DTS type II */
+	case 0x0d: return 2048;         /* DTS type III */
+	case 0x15: return 6144;         /* E-AC-3 */
+	case 0x16: return 15360;        /* TrueHD */
+	default: return 0;
+	}
+}
+
+static uint32_t parse_iec958(struct null_state *state, const uint8_t *p, uint32_t size)
+{
+	uint32_t i = 0, frames = 0, len;
+
+	if (state->rt.encoded_codec == SPA_AUDIO_IEC958_CODEC_PCM) {
+		state->encoded_samples += size / (2 * state->rt.encoded_channels);
+		state->encoded_payload += size;
+		return size / (2 * state->rt.encoded_channels);
+	}
+
+	/* Bursts start with the 16-bit little-endian sync words Pa, Pb */
+	while (i + 8 <= size) {
+		if (p[i] != 0x72 || p[i + 1] != 0xf8 || p[i + 2] != 0x1f || p[i + 3] != 0x4e) {
+			i += 2;
+			continue;
+		}
+
+		/* Pd is the payload length, in bytes for E-AC-3/TrueHD, else bits */
+		len = p[i + 6] | (p[i + 7] << 8);
+		if ((p[i + 4] & 0x1f) != 0x15 && (p[i + 4] & 0x1f) != 0x16)
+			len = (len + 7) / 8;
+
+		state->encoded_samples += iec958_burst_samples(p[i + 4]);
+		state->encoded_payload += len;
+		frames++;
+
+		i += 8 + SPA_ROUND_UP_N(len, 2);
+	}
+	if (i > size)
+		state->encoded_skip = i - size;
+
+	return frames;
+}
+
+static uint32_t parse_aac(struct null_state *state, const uint8_t *p, uint32_t size)
+{
+	uint32_t i = 0, frames = 0, len;
+
+	/* Raw access units: one per buffer */
+	if (size < 7 || p[0] != 0xff || (p[1] & 0xf0) != 0xf0) {
+		state->encoded_samples += size ? 1024 : 0;
+		state->encoded_payload += size;
+		return size ? 1 : 0;
+	}
+
+	/* ADTS: 13-bit frame length and number of raw data blocks */
+	while (i + 7 <= size && p[i] == 0xff && (p[i + 1] & 0xf0) == 0xf0) {
+		len = ((p[i + 3] & 0x03) << 11) | (p[i + 4] << 3) | (p[i + 5] >> 5);
+		if (len < 7)
+			break;
+
+		state->encoded_samples += 1024 * ((p[i + 6] & 0x03) + 1);
+		state->encoded_payload += len;
+		frames++;
+		i += len;
+	}
+	if (i > size)
+		state->encoded_skip = i - size;
+
+	return frames;
+}
+
+/* Bitrates in kbps for MPEG-1 and MPEG-2/2.5 layer II and III */
+static const uint16_t mp3_bitrates[2][2][15] = {
+	{	/* MPEG-1 */
+		{ 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },  /* L3 */
+		{ 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 }, /* L2 */
+	},
+	{	/* MPEG-2/2.5 */
+		{ 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+		{ 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+	},
+};
+static const uint32_t mp3_rates[3] = { 44100, 48000, 32000 };
+
+static uint32_t parse_mp3(struct null_state *state, const uint8_t *p, uint32_t size)
+{
+	uint32_t i = 0, frames = 0;
+
+	while (i + 4 <= size) {
+		uint32_t version, layer, br_index, sr_index, pad, rate, bitrate, samples, len;
+		bool mpeg1;
+
+		if (p[i] != 0xff || (p[i + 1] & 0xe0) != 0xe0) {
+			i++;
+			continue;
+		}
+
+		version = (p[i + 1] >> 3) & 0x3;      /* 3: MPEG-1, 2: MPEG-2, 0: 2.5 */
+		layer = (p[i + 1] >> 1) & 0x3;        /* 1: layer III, 2: layer II */
+		br_index = p[i + 2] >> 4;
+		sr_index = (p[i + 2] >> 2) & 0x3;
+		pad = (p[i + 2] >> 1) & 0x1;
+
+		if (version == 1 || (layer != 1 && layer != 2) ||
+		    br_index == 0 || br_index == 15 || sr_index == 3) {
+			i++;
+			continue;
+		}
+
+		mpeg1 = version == 3;
+		rate = mp3_rates[sr_index] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+		bitrate = mp3_bitrates[mpeg1 ? 0 : 1][layer == 1 ? 0 : 1][br_index] * 1000;
+		samples = (layer == 1 && !mpeg1) ? 576 : 1152;
+		len = samples / 8 * bitrate / rate + pad;
+
+		state->encoded_samples += samples;
+		state->encoded_payload += len;
+		frames++;
+		i += len;
+	}
+	if (i > size)
+		state->encoded_skip = i - size;
+
+	return frames;
+}
+
+static uint32_t parse_opus(struct null_state *state, const uint8_t *p, uint32_t size)
+{
+	/* Frame duration per TOC config, in units of 2.5ms (120 samples at 48kHz) */
+	static const uint8_t durations[32] = {
+		4, 8, 16, 24,  4, 8, 16, 24,  4, 8, 16, 24,     /* SILK */
+		4, 8,  4, 8,                                    /* Hybrid */
+		1, 2, 4, 8,  1, 2, 4, 8,  1, 2, 4, 8,  1, 2, 4, 8,  /* CELT */
+	};
+	uint32_t n_frames;
+
+	if (size == 0)
+		return 0;
+
+	switch (p[0] & 0x3) {
+	case 0:
+		n_frames = 1;
+		break;
+	case 1:
+	case 2:
+		n_frames = 2;
+		break;
+	default:
+		n_frames = size > 1 ? (p[1] & 0x3f) : 0;
+		break;
+	}
+	state->encoded_samples += n_frames * durations[p[0] >> 3] * 120;
+	state->encoded_payload += size;
+
+	/* One packet per buffer */
+	return 1;
+}
+
+uint32_t null_encoded_parse(struct null_state *state, const uint8_t *data, uint32_t size)
+{
+	uint32_t skip = SPA_MIN(state->encoded_skip, size);
+
+	state->encoded_skip -= skip;
+	data += skip;
+	size -= skip;
+
+	switch (state->rt.media_subtype) {
+	case SPA_MEDIA_SUBTYPE_iec958:
+		return parse_iec958(state, data, size);
+	case SPA_MEDIA_SUBTYPE_aac:
+		return parse_aac(state, data, size);
+	case SPA_MEDIA_SUBTYPE_mp3:
+		return parse_mp3(state, data, size);
+	case SPA_MEDIA_SUBTYPE_opus:
+		return parse_opus(state, data, size);
+	default:
+		return 0;
+	}
+}
+
+uint64_t null_encoded_bitrate(struct null_state *state)
+{
+	if (state->encoded_samples == 0)
+		return 0;
+
+	return state->encoded_payload * 8 * state->encoded_rate / state->encoded_samples;
+}
@@ -0,0 +1,419 @@
+/* SPA Null Sink Group Aggregator */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-group.c
+ * @brief SPA Null Sink - Shared process aggregator for grouped null sinks
+ *
+ * When hundreds or thousands of null sinks sit on the same data loop, each
+ * one gets its own process() call that touches its own null_state, which
+ * costs an indirect call and a handful of cache misses per sink per cycle.
+ *
+ * Grouped sinks register with a shared aggregator instead. The aggregator
+ * keeps everything the process path needs in a structure-of-arrays table:
+ *
+ *   slot:     0      1      2      3     ...
+ *   io:      [io0]  [io1]  [io2]  [io3]  ...   spa_io_buffers pointers
+ *   buffers: [b0]   [b1]   [b2]   [b3]   ...   buffer tables
+ *   stride:  [8]    [8]    [4]    [8]    ...   bytes per frame
+ *   frames:  [..]   [..]   [..]   [..]   ...   counters
+ *
+ * GROUP SCHEDULING:
+ * ================
+ * The first member that runs in a cycle and finds its own io area ready
+ * sweeps the whole table linearly and consumes every member whose peer
+ * already provided data. The cycle is told apart by the driver wakeup
+ * time in the clock, so there is at most one sweep per cycle. Members
+ * that run later in the same cycle either find their io area handed
+ * back (SPA_STATUS_NEED_DATA) and return after a single load, or, when
+ * their peer only finished after the sweep, account for their own slot
+ * alone. A cycle therefore costs O(n) however the members are ordered.
+ * Without a clock every member only accounts for itself.
+ *
+ * Only audio/raw members with statistics enabled are swept, the other
+ * kinds keep their own kernels (see null_process_select()).
+ *
+ * THREADING MODEL:
+ * ===============
+ * - The group registry is only touched from the main thread, under a mutex
+ *   because several contexts may load the plugin.
+ * - The table is only touched from the data loop. Main thread changes are
+ *   marshalled with spa_loop_invoke(), so the sweep never takes a lock.
+ * - Members with different data loops never share a group.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <spa/utils/list.h>
+#include <spa/utils/string.h>
+
+#include "null.h"
+
+/** Initial number of slots of a new aggregator table */
+#define GROUP_MIN_CAPACITY	16
+
+/**
+ * @brief Structure-of-arrays member table
+ *
+ * All arrays are carved out of one allocation so a table swap is a single
+ * pointer exchange on the data loop.
+ */
+struct group_table {
+	uint32_t capacity;                 /**< Number of slots in each array */
+	struct spa_io_buffers **io;        /**< Member io, NULL when inactive */
+	struct spa_buffer ***buffers;      /**< Member buffer tables */
+	uint32_t *n_buffers;               /**< Member buffer counts */
+	uint32_t *stride;                  /**< Member bytes per frame */
+	uint64_t *frames;                  /**< Member dropped frames */
+	uint64_t *buffer_count;            /**< Member dropped buffers */
+	struct null_state **member;        /**< Slot owner */
+};
+
+/**
+ * @brief Shared aggregator for one group key on one data loop
+ */
+struct null_group {
+	struct spa_list link;              /**< Link in the group registry */
+	char key[64];                      /**< Group key */
+	struct spa_loop *data_loop;        /**< Data loop shared by all members */
+	struct spa_log *log;               /**< Log of the first member */
+	uint32_t n_members;                /**< Used slots, owned by data loop */
+	struct group_table *table;         /**< Member table, owned by data loop */
+	uint64_t sweep_nsec;               /**< Driver wakeup of the last sweep */
+	uint64_t sweeps;                   /**< Number of sweeps performed */
+};
+
+static pthread_mutex_t group_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct spa_list group_list = SPA_LIST_INIT(&group_list);
+
+static struct group_table *group_table_new(uint32_t capacity)
+{
+	struct group_table *t;
+	size_t ptrs = capacity * sizeof(void *);
+	size_t u32s = capacity * sizeof(uint32_t);
+	size_t u64s = capacity * sizeof(uint64_t);
+	uint8_t *p;
+
+	/* 64-bit counters first so every array stays naturally aligned */
+	t = calloc(1, sizeof(*t) + 2 * u64s + 3 * ptrs + 2 * u32s);
+	if (t == NULL)
+		return NULL;
+
+	p = (uint8_t *) (t + 1);
+	t->capacity = capacity;
+	t->frames = (uint64_t *) p;           p += u64s;
+	t->buffer_count = (uint64_t *) p;     p += u64s;
+	t->io = (struct spa_io_buffers **) p; p += ptrs;
+	t->buffers = (struct spa_buffer ***) p; p += ptrs;
+	t->member = (struct null_state **) p; p += ptrs;
+	t->n_buffers = (uint32_t *) p;        p += u32s;
+	t->stride = (uint32_t *) p;
+
+	return t;
+}
+
+static void group_slot_copy(struct group_table *dst, uint32_t d,
+                            const struct group_table *src, uint32_t s)
+{
+	dst->io[d] = src->io[s];
+	dst->buffers[d] = src->buffers[s];
+	dst->n_buffers[d] = src->n_buffers[s];
+	dst->stride[d] = src->stride[s];
+	dst->frames[d] = src->frames[s];
+	dst->buffer_count[d] = src->buffer_count[s];
+	dst->member[d] = src->member[s];
+}
+
+/*
+ * DATA LOOP OPERATIONS:
+ * ====================
+ * These run on the group's data loop through spa_loop_invoke(), or
+ * directly when the sinks have no data loop.
+ */
+
+static int group_invoke(struct null_group *g, spa_invoke_func_t func,
+                        const void *data, size_t size, void *user_data)
+{
+	if (g->data_loop == NULL)
+		return func(NULL, false, 0, data, size, user_data);
+
+	return spa_loop_invoke(g->data_loop, func, 0, data, size, true, user_data);
+}
+
+struct group_swap {
+	struct group_table *table;
+};
+
+static int do_swap_table(struct spa_loop *loop, bool async, uint32_t seq,
+                         const void *data, size_t size, void *user_data)
+{
+	struct null_group *g = user_data;
+	const struct group_swap *swap = data;
+	struct group_table *old = g->table;
+	uint32_t i;
+
+	for (i = 0; old != NULL && i < g->n_members; i++)
+		group_slot_copy(swap->table, i, old, i);
+
+	g->table = swap->table;
+	return 0;
+}
+
+static int do_add_member(struct spa_loop *loop, bool async, uint32_t seq,
+                         const void *data, size_t size, void *user_data)
+{
+	struct null_group *g = user_data;
+	struct null_state *state = *(struct null_state **) data;
+	struct group_table *t = g->table;
+	uint32_t slot = g->n_members++;
+
+	t->io[slot] = NULL;
+	t->buffers[slot] = state->rt.buffers;
+	t->n_buffers[slot] = 0;
+	t->stride[slot] = 0;
+	t->frames[slot] = state->frame_count;
+	t->buffer_count[slot] = state->buffer_count;
+	t->member[slot] = state;
+
+	state->group_slot = slot;
+	return 0;
+}
+
+static int do_remove_member(struct spa_loop *loop, bool async, uint32_t seq,
+                            const void *data, size_t size, void *user_data)
+{
+	struct null_group *g = user_data;
+	struct null_state *state = *(struct null_state **) data;
+	struct group_table *t = g->table;
+	uint32_t slot = state->group_slot;
+	uint32_t last = --g->n_members;
+
+	state->frame_count = t->frames[slot];
+	state->buffer_count = t->buffer_count[slot];
+
+	/* Move the last member into the hole to keep the table dense */
+	if (slot != last) {
+		group_slot_copy(t, slot, t, last);
+		t->member[slot]->group_slot = slot;
+	}
+	return 0;
+}
+
+/*
+ * GROUP REGISTRY:
+ * ==============
+ * Main thread side of the aggregator.
+ */
+
+static struct null_group *group_find(const char *key, struct spa_loop *loop)
+{
+	struct null_group *g;
+
+	spa_list_for_each(g, &group_list, link) {
+		if (g->data_loop == loop && spa_streq(g->key, key))
+			return g;
+	}
+	return NULL;
+}
+
+static struct null_group *group_new(struct null_state *state, const char *key)
+{
+	struct null_group *g;
+
+	g = calloc(1, sizeof(*g));
+	if (g == NULL)
+		return NULL;
+
+	g->table = group_table_new(GROUP_MIN_CAPACITY);
+	if (g->table == NULL) {
+		free(g);
+		return NULL;
+	}
+	spa_scnprintf(g->key, sizeof(g->key), "%s", key);
+	g->data_loop = state->data_loop;
+	g->log = state->log;
+
+	spa_list_append(&group_list, &g->link);
+	spa_log_info(state->log, "null-group %p: created group '%s'", g, g->key);
+
+	return g;
+}
+
+static void group_free(struct null_group *g)
+{
+	spa_log_info(g->log, "null-group %p: destroyed group '%s' after %" PRIu64 " sweeps",
+		     g, g->key, g->sweeps);
+	spa_list_remove(&g->link);
+	free(g->table);
+	free(g);
+}
+
+int null_group_join(struct null_state *state, const char *key)
+{
+	struct null_group *g;
+	int res = 0;
+
+	spa_return_val_if_fail(state != NULL, -EINVAL);
+	spa_return_val_if_fail(key != NULL, -EINVAL);
+	spa_return_val_if_fail(state->group == NULL, -EBUSY);
+
+	pthread_mutex_lock(&group_lock);
+
+	g = group_find(key, state->data_loop);
+	if (g == NULL && (g = group_new(state, key)) == NULL) {
+		res = -errno;
+		goto done;
+	}
+
+	/*
+	 * GROW THE TABLE:
+	 * ==============
+	 * Allocation happens here on the main thread; the data loop only
+	 * copies the live slots and swaps the pointer.
+	 */
+	if (g->n_members == g->table->capacity) {
+		struct group_table *old = g->table;
+		struct group_swap swap;
+
+		swap.table = group_table_new(old->capacity * 2);
+		if (swap.table == NULL) {
+			res = -errno;
+			goto done;
+		}
+		group_invoke(g, do_swap_table, &swap, sizeof(swap), g);
+		free(old);
+	}
+
+	state->group = g;
+	group_invoke(g, do_add_member, &state, sizeof(state), g);
+
+	spa_log_info(state->log, "null-sink %p: joined group '%s' slot %u (%u members)",
+		     state, g->key, state->group_slot, g->n_members);
+done:
+	pthread_mutex_unlock(&group_lock);
+	return res;
+}
+
+void null_group_leave(struct null_state *state)
+{
+	struct null_group *g;
+
+	if (state == NULL || (g = state->group) == NULL)
+		return;
+
+	pthread_mutex_lock(&group_lock);
+
+	group_invoke(g, do_remove_member, &state, sizeof(state), g);
+	state->group = NULL;
+
+	spa_log_info(state->log, "null-sink %p: left group '%s' (%u members)",
+		     state, g->key, g->n_members);
+
+	if (g->n_members == 0)
+		group_free(g);
+
+	pthread_mutex_unlock(&group_lock);
+}
+
+void null_group_apply(struct null_state *state)
+{
+	struct group_table *t;
+	uint32_t slot;
+
+	if (state->group == NULL)
+		return;
+
+	/*
+	 * Data loop side of the config swap, so the slot always matches the
+	 * buffer table in rt that it points to.
+	 */
+	t = state->group->table;
+	slot = state->group_slot;
+	t->io[slot] = state->rt.grouped ? state->rt.io : NULL;
+	t->n_buffers[slot] = state->rt.n_buffers;
+	t->stride[slot] = state->rt.frame_stride;
+}
+
+void null_group_get_stats(struct null_state *state,
+                          uint64_t *frames, uint64_t *buffers)
+{
+	struct group_table *t = state->group->table;
+
+	*frames = t->frames[state->group_slot];
+	*buffers = t->buffer_count[state->group_slot];
+}
+
+/*
+ * THE SWEEP:
+ * =========
+ * Real-time context. One pass over the SoA table, touching only the
+ * arrays and the io areas, never the member null_state structures.
+ */
+static inline void group_account(struct group_table *t, uint32_t i)
+{
+	struct spa_io_buffers *io = t->io[i];
+	struct spa_buffer *buf;
+	uint32_t id;
+
+	if (io == NULL || io->status != SPA_STATUS_HAVE_DATA)
+		return;
+
+	id = io->buffer_id;
+	if (spa_likely(id < t->n_buffers[i]) &&
+	    (buf = t->buffers[i][id]) != NULL &&
+	    buf->datas[0].chunk != NULL &&
+	    t->stride[i] != 0) {
+		t->frames[i] += buf->datas[0].chunk->size / t->stride[i];
+		t->buffer_count[i]++;
+	}
+
+	io->buffer_id = SPA_ID_INVALID;
+	io->status = SPA_STATUS_NEED_DATA;
+}
+
+static void group_sweep(struct null_group *g)
+{
+	struct group_table *t = g->table;
+	uint32_t i, n = g->n_members;
+
+	for (i = 0; i < n; i++)
+		group_account(t, i);
+	g->sweeps++;
+}
+
+int null_group_process(struct null_state *state)
+{
+	struct null_group *g = state->group;
+	struct spa_io_buffers *io = state->rt.io;
+	struct spa_io_clock *clock;
+	uint64_t nsec;
+
+	/*
+	 * An earlier member already swept this cycle (or the peer has not
+	 * produced anything yet): nothing to do for this member.
+	 */
+	if (spa_unlikely(io == NULL) || io->status != SPA_STATUS_HAVE_DATA) {
+		state->empty_count++;
+		return SPA_STATUS_NEED_DATA;
+	}
+
+	clock = state->rt.clock ? state->rt.clock :
+		state->rt.position ? &state->rt.position->clock : NULL;
+	nsec = clock ? clock->nsec : 0;
+
+	if (nsec != 0 && nsec != g->sweep_nsec) {
+		/* First ready member of this cycle */
+		g->sweep_nsec = nsec;
+		group_sweep(g);
+	} else {
+		/* Swept already, this member's peer finished after the sweep */
+		group_account(g->table, state->group_slot);
+	}
+
+	return SPA_STATUS_HAVE_DATA;
+}
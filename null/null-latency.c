@@ -0,0 +1,160 @@
+/* SPA Null Sink Latency Reporting */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-latency.c
+ * @brief SPA Null Sink - Latency and ProcessLatency params
+ *
+ * A real sink adds latency between the moment a sample is consumed and
+ * the moment it is heard. The null sink can emulate such a device so
+ * latency compensation logic can be tested against a known value.
+ *
+ * LATENCY PARAMS:
+ * ==============
+ * - SPA_PARAM_ProcessLatency (node and port): the emulated device
+ *   latency as quantum + rate + ns, from the latency.internal.*
+ *   properties or set_param. Defaults to zero.
+ *
+ * - SPA_PARAM_Latency (port), one per direction:
+ *     SPA_DIRECTION_INPUT   latency from the input port to the "device",
+ *                           which is the process latency
+ *     SPA_DIRECTION_OUTPUT  upstream latency, as set by the graph
+ *
+ * DEVICE DELAY:
+ * ============
+ * When the null sink drives the graph, null_latency_process() writes
+ * the process latency converted to samples of the clock rate to
+ * spa_io_clock.delay every cycle, so its consumption position is
+ * reported that far behind, like a device with a hardware queue. The
+ * quantum part follows the duration of the current cycle. A follower
+ * leaves the clock of its driver alone.
+ *
+ * The null sink has no timer of its own and never asks to drive, so in
+ * a normal graph it follows and the clock delay is not emulated: it
+ * only contributes the latency through ProcessLatency and Latency, like
+ * any follower. The delay takes effect when the host makes the sink
+ * the driver of its graph and triggers its cycles.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+
+#include <spa/param/latency-utils.h>
+
+#include "null.h"
+
+void null_latency_init(struct null_state *state)
+{
+	state->process_latency = SPA_PROCESS_LATENCY_INFO_INIT();
+	state->port_latency[SPA_DIRECTION_INPUT] = SPA_LATENCY_INFO(SPA_DIRECTION_INPUT);
+	state->port_latency[SPA_DIRECTION_OUTPUT] = SPA_LATENCY_INFO(SPA_DIRECTION_OUTPUT);
+}
+
+static void update_latency(struct null_state *state)
+{
+	struct spa_latency_info info = SPA_LATENCY_INFO(SPA_DIRECTION_INPUT);
+
+	/* Downstream of the input port there is only the emulated device */
+	spa_process_latency_info_add(&state->process_latency, &info);
+	state->port_latency[SPA_DIRECTION_INPUT] = info;
+}
+
+bool null_latency_active(const struct spa_process_latency_info *l)
+{
+	return l->quantum != 0.0f || l->rate != 0 || l->ns != 0;
+}
+
+int null_latency_process(struct null_state *state)
+{
+	const struct spa_process_latency_info *l = &state->rt.latency;
+	struct spa_io_clock *clock = state->rt.clock;
+	struct spa_io_position *position = state->rt.position;
+	uint32_t rate;
+	int64_t delay;
+
+	/* Only the driver owns the clock it reports its delay in */
+	if (spa_likely(clock != NULL && position != NULL) &&
+	    position->clock.id == clock->id) {
+		rate = clock->rate.denom ? clock->rate.denom / SPA_MAX(clock->rate.num, 1u) : 48000;
+
+		delay = (int64_t) (l->quantum * clock->duration);
+		delay += l->rate;
+		delay += l->ns * rate / SPA_NSEC_PER_SEC;
+
+		clock->delay = delay;
+	}
+
+	return state->rt.latency_kernel(state);
+}
+
+int null_latency_enum_param(struct null_state *state, uint32_t id, uint32_t index,
+                            bool port, struct spa_pod_builder *b, struct spa_pod **param)
+{
+	switch (id) {
+	case SPA_PARAM_ProcessLatency:
+		if (index > 0)
+			return 0;
+		*param = spa_process_latency_build(b, id, &state->process_latency);
+		return 1;
+
+	case SPA_PARAM_Latency:
+		if (!port || index >= SPA_N_ELEMENTS(state->port_latency))
+			return 0;
+		*param = spa_latency_build(b, id, &state->port_latency[index]);
+		return 1;
+
+	default:
+		return 0;
+	}
+}
+
+int null_latency_set_param(struct null_state *state, uint32_t id,
+                           const struct spa_pod *param)
+{
+	struct spa_process_latency_info process;
+	struct spa_latency_info info;
+	int res;
+
+	switch (id) {
+	case SPA_PARAM_ProcessLatency:
+		if (param == NULL)
+			process = SPA_PROCESS_LATENCY_INFO_INIT();
+		else if ((res = spa_process_latency_parse(param, &process)) < 0)
+			return res;
+
+		state->process_latency = process;
+		update_latency(state);
+
+		spa_log_info(state->log, "null-sink %p: process latency quantum:%f rate:%u ns:%" PRIu64,
+			     state, process.quantum, process.rate, process.ns);
+		return 0;
+
+	case SPA_PARAM_Latency:
+		if (param == NULL)
+			return 0;
+		if ((res = spa_latency_parse(param, &info)) < 0)
+			return res;
+
+		/* Only the upstream latency can be set, ours follows from ProcessLatency */
+		if (info.direction != SPA_DIRECTION_OUTPUT)
+			return -EINVAL;
+
+		state->port_latency[SPA_DIRECTION_OUTPUT] = info;
+		spa_log_debug(state->log, "null-sink %p: upstream latency %f-%f quantum "
+			      "%u-%u rate %" PRIu64 "-%" PRIu64 " ns", state,
+			      info.min_quantum, info.max_quantum, info.min_rate,
+			      info.max_rate, info.min_ns, info.max_ns);
+		return 0;
+
+	default:
+		return -ENOTSUP;
+	}
+}
+
+void null_latency_set_process(struct null_state *state,
+                              const struct spa_process_latency_info *info)
+{
+	state->process_latency = *info;
+	update_latency(state);
+}
@@ -0,0 +1,883 @@
+/* SPA Null Loopback Node */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-loopback.c
+ * @brief SPA Null Loopback - Null sink with a delayed output port
+ *
+ * The loopback node consumes audio on its input port like the null sink
+ * and re-exposes every buffer on its output port one quantum later. It
+ * is a cheap monitor point and delay line for graph benchmarks, without
+ * the audioadapter/audioconvert stack.
+ *
+ * BUFFERS:
+ * =======
+ * The host gives each port its own pool, input and output buffers are
+ * never the same. The input data is copied into a free buffer of the
+ * output pool right away, so the input buffer is handed back in the
+ * same cycle (the input port sets SPA_PORT_FLAG_NO_REF like the null
+ * sink), and the copy is published in the next one. Output buffers
+ * come back through the output io area or port_reuse_buffer() into a
+ * free mask, process() never allocates.
+ *
+ * The copy needs the data of both pools in memory, so the Buffers param
+ * only asks for MemPtr and use_buffers() refuses planes without data.
+ *
+ * CYCLE:
+ * =====
+ *   1. take back the output buffer downstream consumed
+ *   2. publish the copy kept in the previous cycle
+ *   3. copy the new input into a free output buffer
+ *
+ * When downstream has not consumed the previous output yet, the kept
+ * buffer is dropped and counted as an overrun. With the output not
+ * linked only the input is consumed and counted, like the null sink.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include <spa/utils/result.h>
+#include <spa/utils/string.h>
+#include <spa/buffer/buffer.h>
+#include <spa/param/buffers.h>
+#include <spa/param/latency-utils.h>
+#include <spa/pod/builder.h>
+#include <spa/pod/filter.h>
+#include <spa/param/audio/format-utils.h>
+
+#include "null.h"
+
+/** Ports are indexed by their spa_direction */
+#define N_PORTS		2
+
+enum {
+	PORT_EnumFormat,
+	PORT_Format,
+	PORT_Buffers,
+	N_PORT_PARAMS,
+};
+
+struct port {
+	uint64_t info_all;
+	struct spa_port_info info;
+	struct spa_param_info params[N_PORT_PARAMS];
+
+	bool have_format;             /**< Format set on this port */
+	struct spa_io_buffers *io;
+	struct spa_buffer *buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+};
+
+struct loopback {
+	struct spa_handle handle;
+	struct spa_node node;
+
+	struct spa_log *log;
+	struct spa_loop *data_loop;
+	struct spa_hook_list hooks;
+
+	uint64_t info_all;
+	struct spa_node_info info;
+	struct spa_param_info params[1];
+
+	struct port ports[N_PORTS];
+
+	bool have_format;             /**< Format set on at least one port */
+	struct spa_audio_info_raw format;
+	uint32_t stride;              /**< Bytes per frame of one plane */
+
+	/* Data loop state, changed by the control plane only through invoke */
+	bool active;                  /**< The input has buffers */
+	uint32_t free_mask;           /**< Output buffers free for copies */
+	uint32_t pending;             /**< Published next cycle, or SPA_ID_INVALID */
+	bool started;
+
+	uint64_t frame_count;         /**< Frames passed through */
+	uint64_t buffer_count;        /**< Buffers passed through */
+	uint64_t copy_count;          /**< Buffers copied into the output pool */
+	uint64_t overrun_count;       /**< Buffers dropped, downstream too slow */
+};
+
+/*
+ * BUFFER RECYCLING:
+ * ================
+ */
+
+static inline void recycle(struct loopback *this, uint32_t id)
+{
+	this->free_mask |= 1u << id;
+}
+
+static inline uint32_t take_bit(uint32_t *mask)
+{
+	uint32_t id;
+
+	if (*mask == 0)
+		return SPA_ID_INVALID;
+	id = __builtin_ctz(*mask);
+	*mask &= ~(1u << id);
+	return id;
+}
+
+/** Copy the planes of an input buffer into a free output buffer */
+static uint32_t copy_buffer(struct loopback *this, struct spa_buffer *src)
+{
+	struct port *out = &this->ports[SPA_DIRECTION_OUTPUT];
+	struct spa_buffer *dst;
+	uint32_t id, i, offset, size;
+
+	if ((id = take_bit(&this->free_mask)) == SPA_ID_INVALID)
+		return SPA_ID_INVALID;
+
+	dst = out->buffers[id];
+	for (i = 0; i < dst->n_datas; i++) {
+		struct spa_data *dd = &dst->datas[i];
+		struct spa_data *sd = i < src->n_datas ? &src->datas[i] : NULL;
+
+		/* Both pools are checked for data in use_buffers() */
+		size = 0;
+		if (sd != NULL && sd->chunk != NULL) {
+			offset = SPA_MIN(sd->chunk->offset, sd->maxsize);
+			size = SPA_MIN(sd->chunk->size, sd->maxsize - offset);
+			size = SPA_MIN(size, dd->maxsize);
+			memcpy(dd->data, SPA_PTROFF(sd->data, offset, void), size);
+		}
+		if (dd->chunk != NULL) {
+			dd->chunk->offset = 0;
+			dd->chunk->size = size;
+			dd->chunk->stride = this->stride;
+			dd->chunk->flags = sd != NULL && sd->chunk != NULL ? sd->chunk->flags : 0;
+		}
+	}
+	this->copy_count++;
+	return id;
+}
+
+/*
+ * PROCESSING:
+ * ==========
+ */
+
+static int impl_node_process(void *object)
+{
+	struct loopback *this = object;
+	struct port *in = &this->ports[SPA_DIRECTION_INPUT];
+	struct port *out = &this->ports[SPA_DIRECTION_OUTPUT];
+	struct spa_io_buffers *iio = in->io, *oio = out->io;
+	struct spa_buffer *buf;
+	uint32_t id;
+	int status = SPA_STATUS_NEED_DATA;
+
+	if (spa_unlikely(!this->started || iio == NULL || !this->active))
+		return SPA_STATUS_OK;
+
+	/* An unlinked output has no buffers, steps 1, 2 and the copy are skipped */
+	if (oio != NULL && out->n_buffers > 0) {
+		/* 1. Downstream handed back the buffer it consumed */
+		if (oio->status != SPA_STATUS_HAVE_DATA && oio->buffer_id < out->n_buffers) {
+			recycle(this, oio->buffer_id);
+			oio->buffer_id = SPA_ID_INVALID;
+		}
+
+		/* 2. Publish what was kept in the previous cycle */
+		if (this->pending != SPA_ID_INVALID) {
+			if (oio->status != SPA_STATUS_HAVE_DATA) {
+				oio->buffer_id = this->pending;
+				oio->status = SPA_STATUS_HAVE_DATA;
+			} else {
+				this->overrun_count++;
+				recycle(this, this->pending);
+			}
+			this->pending = SPA_ID_INVALID;
+		}
+		if (oio->status == SPA_STATUS_HAVE_DATA)
+			status |= SPA_STATUS_HAVE_DATA;
+	} else {
+		oio = NULL;
+	}
+
+	/* 3. Copy the new input, the input buffer is free again right away */
+	if (iio->status == SPA_STATUS_HAVE_DATA) {
+		id = iio->buffer_id;
+		iio->buffer_id = SPA_ID_INVALID;
+		iio->status = SPA_STATUS_NEED_DATA;
+
+		if (spa_likely(id < in->n_buffers)) {
+			buf = in->buffers[id];
+			if (buf->n_datas > 0 && buf->datas[0].chunk != NULL && this->stride != 0)
+				this->frame_count += buf->datas[0].chunk->size / this->stride;
+			this->buffer_count++;
+
+			if (oio != NULL &&
+			    (this->pending = copy_buffer(this, buf)) == SPA_ID_INVALID)
+				this->overrun_count++;
+		}
+	}
+
+	return status;
+}
+
+/*
+ * DATA LOOP STATE:
+ * ===============
+ * The active flag, the free mask and the started flag are read by
+ * process(), so they are written on the data loop with a blocking
+ * invoke, like the null sink swaps its config.
+ */
+
+struct loopback_update {
+	bool active;
+	uint32_t free_mask;
+	bool started;
+};
+
+static int do_update(struct spa_loop *loop, bool async, uint32_t seq,
+                     const void *data, size_t size, void *user_data)
+{
+	struct loopback *this = user_data;
+	const struct loopback_update *u = data;
+	struct spa_io_buffers *oio = this->ports[SPA_DIRECTION_OUTPUT].io;
+
+	if (u->active != this->active || !u->started) {
+		/* Buffers of the old set or a stopped node are not published */
+		this->pending = SPA_ID_INVALID;
+		this->free_mask = u->free_mask;
+		/* The one downstream holds comes back through step 1 */
+		if (oio != NULL && oio->buffer_id < MAX_BUFFERS)
+			this->free_mask &= ~(1u << oio->buffer_id);
+	}
+	this->active = u->active;
+	this->started = u->started;
+	return 0;
+}
+
+static void apply(struct loopback *this, bool active, bool started)
+{
+	struct loopback_update u = { .active = active, .started = started };
+
+	if (active)
+		u.free_mask = (1u << this->ports[SPA_DIRECTION_OUTPUT].n_buffers) - 1;
+
+	if (this->data_loop != NULL)
+		spa_loop_invoke(this->data_loop, do_update, 0, &u, sizeof(u), true, this);
+	else
+		do_update(NULL, false, 0, &u, sizeof(u), this);
+}
+
+/**
+ * Activate process() once the input has buffers, the output pool is
+ * only needed for the copy
+ */
+static void update(struct loopback *this, bool started)
+{
+	apply(this, this->ports[SPA_DIRECTION_INPUT].n_buffers > 0, started);
+}
+
+/*
+ * INFO:
+ * ====
+ */
+
+static void emit_node_info(struct loopback *this, bool full)
+{
+	uint64_t old = full ? this->info.change_mask : 0;
+
+	if (full)
+		this->info.change_mask = this->info_all;
+	if (this->info.change_mask) {
+		spa_node_emit_info(&this->hooks, &this->info);
+		this->info.change_mask = old;
+	}
+}
+
+static void emit_port_info(struct loopback *this, enum spa_direction direction, bool full)
+{
+	struct port *port = &this->ports[direction];
+	uint64_t old = full ? port->info.change_mask : 0;
+	uint32_t i;
+
+	if (full)
+		port->info.change_mask = port->info_all;
+	if (port->info.change_mask == 0)
+		return;
+
+	if (port->info.change_mask & SPA_PORT_CHANGE_MASK_PARAMS) {
+		for (i = 0; i < port->info.n_params; i++) {
+			if (port->params[i].user > 0) {
+				port->params[i].flags ^= SPA_PARAM_INFO_SERIAL;
+				port->params[i].user = 0;
+			}
+		}
+	}
+	spa_node_emit_port_info(&this->hooks, direction, 0, &port->info);
+	port->info.change_mask = old;
+}
+
+static int impl_node_add_listener(void *object,
+                                  struct spa_hook *listener,
+                                  const struct spa_node_events *events,
+                                  void *data)
+{
+	struct loopback *this = object;
+	struct spa_hook_list save;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	spa_hook_list_isolate(&this->hooks, &save, listener, events, data);
+
+	emit_node_info(this, true);
+	emit_port_info(this, SPA_DIRECTION_INPUT, true);
+	emit_port_info(this, SPA_DIRECTION_OUTPUT, true);
+
+	spa_hook_list_join(&this->hooks, &save);
+
+	return 0;
+}
+
+static int impl_node_sync(void *object, int seq)
+{
+	struct loopback *this = object;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	spa_node_emit_result(&this->hooks, seq, 0, 0, NULL);
+
+	return 0;
+}
+
+/*
+ * NODE METHODS:
+ * ============
+ */
+
+static int impl_node_enum_params(void *object, int seq,
+                                 uint32_t id, uint32_t start, uint32_t num,
+                                 const struct spa_pod *filter)
+{
+	struct loopback *this = object;
+	struct spa_process_latency_info latency = SPA_PROCESS_LATENCY_INFO_INIT(.quantum = 1.0f);
+	struct spa_pod *param;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[256];
+	struct spa_result_node_params result;
+	uint32_t count = 0;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(num != 0, -EINVAL);
+
+	result.id = id;
+	result.next = start;
+
+next:
+	result.index = result.next++;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (id) {
+	case SPA_PARAM_ProcessLatency:
+		/* The output lags the input by one quantum */
+		if (result.index > 0)
+			return 0;
+		param = spa_process_latency_build(&b, id, &latency);
+		break;
+	default:
+		return 0;
+	}
+
+	if (spa_pod_filter(&b, &result.param, param, filter) < 0)
+		goto next;
+
+	spa_node_emit_result(&this->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
+
+	if (++count != num)
+		goto next;
+
+	return 0;
+}
+
+static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
+                               const struct spa_pod *param)
+{
+	return -ENOTSUP;
+}
+
+static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
+{
+	switch (id) {
+	case SPA_IO_Position:
+	case SPA_IO_Clock:
+		/* The delay is one quantum whatever its size */
+		return 0;
+	default:
+		return -ENOENT;
+	}
+}
+
+static int do_flush(struct spa_loop *loop, bool async, uint32_t seq,
+                    const void *data, size_t size, void *user_data)
+{
+	struct loopback *this = user_data;
+
+	if (this->pending != SPA_ID_INVALID) {
+		recycle(this, this->pending);
+		this->pending = SPA_ID_INVALID;
+	}
+	return 0;
+}
+
+static int impl_node_send_command(void *object, const struct spa_command *command)
+{
+	struct loopback *this = object;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(command != NULL, -EINVAL);
+
+	switch (SPA_NODE_COMMAND_ID(command)) {
+	case SPA_NODE_COMMAND_Start:
+		if (!this->have_format) {
+			spa_log_error(this->log, "null-loopback %p: no format configured", this);
+			return -EIO;
+		}
+		update(this, true);
+		spa_log_info(this->log, "null-loopback %p: started%s", this,
+			     this->active ? "" : ", waiting for buffers");
+		break;
+
+	case SPA_NODE_COMMAND_Suspend:
+	case SPA_NODE_COMMAND_Pause:
+		/* After the invoke process() is idle, the counters are final */
+		update(this, false);
+		spa_log_info(this->log, "null-loopback %p: stopped after %" PRIu64
+			     " frames in %" PRIu64 " buffers, %" PRIu64 " copied, %"
+			     PRIu64 " overruns", this, this->frame_count,
+			     this->buffer_count, this->copy_count, this->overrun_count);
+		break;
+
+	case SPA_NODE_COMMAND_Flush:
+		/* Drop the buffer waiting for the next cycle */
+		if (this->data_loop != NULL)
+			spa_loop_invoke(this->data_loop, do_flush, 0, NULL, 0, true, this);
+		else
+			do_flush(NULL, false, 0, NULL, 0, this);
+		break;
+
+	default:
+		return -ENOTSUP;
+	}
+	return 0;
+}
+
+/*
+ * PORT METHODS:
+ * ============
+ */
+
+static int impl_node_port_enum_params(void *object, int seq,
+                                      enum spa_direction direction, uint32_t port_id,
+                                      uint32_t id, uint32_t start, uint32_t num,
+                                      const struct spa_pod *filter)
+{
+	struct loopback *this = object;
+	struct spa_pod *param;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_result_node_params result;
+	uint32_t count = 0, blocks;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(num != 0, -EINVAL);
+
+	if (direction >= N_PORTS || port_id != 0)
+		return -EINVAL;
+
+	result.id = id;
+	result.next = start;
+
+next:
+	result.index = result.next++;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (id) {
+	case SPA_PARAM_EnumFormat:
+		/* Both ports carry the same format, once set it is the only one */
+		if (result.index > 0)
+			return 0;
+		if (this->have_format)
+			param = spa_format_audio_raw_build(&b, id, &this->format);
+		else
+			param = spa_format_audio_raw_build(&b, id,
+				&SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32P));
+		break;
+
+	case SPA_PARAM_Format:
+		if (!this->ports[direction].have_format || result.index > 0)
+			return 0;
+		param = spa_format_audio_raw_build(&b, id, &this->format);
+		break;
+
+	case SPA_PARAM_Buffers:
+		if (!this->ports[direction].have_format || result.index > 0)
+			return 0;
+
+		blocks = SPA_AUDIO_FORMAT_IS_PLANAR(this->format.format) ?
+			this->format.channels : 1;
+
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_ParamBuffers, id,
+			/* One output buffer is with downstream while the next is copied */
+			SPA_PARAM_BUFFERS_buffers,  SPA_POD_CHOICE_RANGE_Int(2, 2, MAX_BUFFERS),
+			SPA_PARAM_BUFFERS_blocks,   SPA_POD_Int(blocks),
+			SPA_PARAM_BUFFERS_size,     SPA_POD_CHOICE_RANGE_Int(
+							DEFAULT_FRAMES * this->stride, 1, INT32_MAX),
+			SPA_PARAM_BUFFERS_stride,   SPA_POD_Int(this->stride),
+			SPA_PARAM_BUFFERS_dataType, SPA_POD_CHOICE_FLAGS_Int(1 << SPA_DATA_MemPtr));
+		break;
+
+	default:
+		return 0;
+	}
+
+	if (spa_pod_filter(&b, &result.param, param, filter) < 0)
+		goto next;
+
+	spa_node_emit_result(&this->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
+
+	if (++count != num)
+		goto next;
+
+	return 0;
+}
+
+/** Only called after apply(false), process() no longer reads them */
+static void clear_buffers(struct port *port)
+{
+	uint32_t i;
+
+	for (i = 0; i < port->n_buffers; i++)
+		port->buffers[i] = NULL;
+	port->n_buffers = 0;
+}
+
+static bool same_format(const struct spa_audio_info_raw *a, const struct spa_audio_info_raw *b)
+{
+	return a->format == b->format && a->rate == b->rate && a->channels == b->channels;
+}
+
+/**
+ * The format set on one port narrows EnumFormat of both, Format and
+ * Buffers only change on the port itself.
+ */
+static void format_changed(struct loopback *this, enum spa_direction direction)
+{
+	struct port *port = &this->ports[direction];
+	uint32_t i;
+
+	port->params[PORT_Format].flags = port->have_format ?
+		SPA_PARAM_INFO_READWRITE : SPA_PARAM_INFO_WRITE;
+	port->params[PORT_Format].user++;
+	port->params[PORT_Buffers].flags = port->have_format ? SPA_PARAM_INFO_READ : 0;
+	port->params[PORT_Buffers].user++;
+
+	for (i = 0; i < N_PORTS; i++) {
+		this->ports[i].params[PORT_EnumFormat].user++;
+		this->ports[i].info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+		emit_port_info(this, i, false);
+	}
+}
+
+static int impl_node_port_set_param(void *object,
+                                    enum spa_direction direction, uint32_t port_id,
+                                    uint32_t id, uint32_t flags,
+                                    const struct spa_pod *param)
+{
+	struct loopback *this = object;
+	struct spa_audio_info info = { 0 };
+	struct port *port, *other;
+	int res;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	if (direction >= N_PORTS || port_id != 0)
+		return -EINVAL;
+	if (id != SPA_PARAM_Format)
+		return -ENOTSUP;
+
+	/*
+	 * The host negotiates each link on its own: a format only touches
+	 * the buffers of its own port, the other port keeps running.
+	 */
+	port = &this->ports[direction];
+	other = &this->ports[SPA_DIRECTION_REVERSE(direction)];
+
+	if (param == NULL) {
+		port->have_format = false;
+		if (!other->have_format) {
+			this->have_format = false;
+			this->stride = 0;
+		}
+		goto done;
+	}
+
+	if ((res = spa_format_parse(param, &info.media_type, &info.media_subtype)) < 0)
+		return res;
+	if (info.media_type != SPA_MEDIA_TYPE_audio ||
+	    info.media_subtype != SPA_MEDIA_SUBTYPE_raw)
+		return -EINVAL;
+	if ((res = spa_format_audio_raw_parse(param, &info.info.raw)) < 0)
+		return res;
+
+	if ((res = null_audio_check_raw(this->log, "null-loopback", this, &info.info.raw)) < 0)
+		return res;
+
+	/* Data is copied as is, the other port already fixed the format */
+	if (other->have_format && !same_format(&this->format, &info.info.raw)) {
+		spa_log_error(this->log, "null-loopback %p: %s format does not match the %s",
+			      this, direction == SPA_DIRECTION_INPUT ? "input" : "output",
+			      direction == SPA_DIRECTION_INPUT ? "output" : "input");
+		return -EINVAL;
+	}
+
+	this->format = info.info.raw;
+	this->stride = null_audio_frame_stride(&info.info.raw);
+	this->have_format = true;
+	port->have_format = true;
+
+	spa_log_info(this->log, "null-loopback %p: %s format %u channels, %u Hz, %u bytes/frame",
+		     this, direction == SPA_DIRECTION_INPUT ? "input" : "output",
+		     this->format.channels, this->format.rate, this->stride);
+done:
+	apply(this, false, this->started);
+	clear_buffers(port);
+	format_changed(this, direction);
+	return 0;
+}
+
+static int impl_node_port_use_buffers(void *object,
+                                      enum spa_direction direction, uint32_t port_id,
+                                      uint32_t flags,
+                                      struct spa_buffer **buffers, uint32_t n_buffers)
+{
+	struct loopback *this = object;
+	struct port *port;
+	uint32_t i, j;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	if (direction >= N_PORTS || port_id != 0)
+		return -EINVAL;
+	if (n_buffers > MAX_BUFFERS)
+		return -ENOSPC;
+	if (n_buffers > 0 && !this->ports[direction].have_format)
+		return -EIO;
+
+	/* process() copies between the pools, every plane must be mapped */
+	for (i = 0; i < n_buffers; i++) {
+		for (j = 0; j < buffers[i]->n_datas; j++) {
+			if (buffers[i]->datas[j].data == NULL) {
+				spa_log_error(this->log, "null-loopback %p: buffer %u plane %u "
+					      "has no data", this, i, j);
+				return -EINVAL;
+			}
+		}
+	}
+
+	port = &this->ports[direction];
+
+	/* Stop using the old set on the data loop before it goes away */
+	apply(this, false, this->started);
+	clear_buffers(port);
+
+	for (i = 0; i < n_buffers; i++)
+		port->buffers[i] = buffers[i];
+	port->n_buffers = n_buffers;
+
+	update(this, this->started);
+
+	spa_log_debug(this->log, "null-loopback %p: %s port using %u buffers", this,
+		      direction == SPA_DIRECTION_INPUT ? "input" : "output", n_buffers);
+	return 0;
+}
+
+static int impl_node_port_set_io(void *object,
+                                 enum spa_direction direction, uint32_t port_id,
+                                 uint32_t id, void *data, size_t size)
+{
+	struct loopback *this = object;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	if (direction >= N_PORTS || port_id != 0)
+		return -EINVAL;
+	if (id != SPA_IO_Buffers)
+		return -ENOENT;
+
+	this->ports[direction].io = size >= sizeof(struct spa_io_buffers) ? data : NULL;
+	return 0;
+}
+
+static int impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t buffer_id)
+{
+	struct loopback *this = object;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	/* Only output buffers come back this way, called from the data loop */
+	if (port_id != 0 || buffer_id >= this->ports[SPA_DIRECTION_OUTPUT].n_buffers)
+		return -EINVAL;
+
+	recycle(this, buffer_id);
+	return 0;
+}
+
+static const struct spa_node_methods impl_node = {
+	SPA_VERSION_NODE_METHODS,
+	.add_listener = impl_node_add_listener,
+	.sync = impl_node_sync,
+	.enum_params = impl_node_enum_params,
+	.set_param = impl_node_set_param,
+	.set_io = impl_node_set_io,
+	.send_command = impl_node_send_command,
+	.port_enum_params = impl_node_port_enum_params,
+	.port_set_param = impl_node_port_set_param,
+	.port_use_buffers = impl_node_port_use_buffers,
+	.port_set_io = impl_node_port_set_io,
+	.port_reuse_buffer = impl_node_port_reuse_buffer,
+	.process = impl_node_process,
+};
+
+/*
+ * FACTORY:
+ * =======
+ */
+
+static int impl_get_interface(struct spa_handle *handle, const char *type, void **interface)
+{
+	struct loopback *this;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+	spa_return_val_if_fail(interface != NULL, -EINVAL);
+
+	this = (struct loopback *) handle;
+
+	if (!spa_streq(type, SPA_TYPE_INTERFACE_Node))
+		return -ENOENT;
+
+	*interface = &this->node;
+	return 0;
+}
+
+static int impl_clear(struct spa_handle *handle)
+{
+	struct loopback *this = (struct loopback *) handle;
+
+	spa_hook_list_clean(&this->hooks);
+	return 0;
+}
+
+static size_t impl_get_size(const struct spa_handle_factory *factory,
+                            const struct spa_dict *info)
+{
+	return sizeof(struct loopback);
+}
+
+static void init_port(struct loopback *this, enum spa_direction direction)
+{
+	struct port *port = &this->ports[direction];
+
+	port->info_all = SPA_PORT_CHANGE_MASK_FLAGS | SPA_PORT_CHANGE_MASK_PARAMS;
+	port->info = SPA_PORT_INFO_INIT();
+	/* The input is copied in the cycle it arrives, like the null sink */
+	port->info.flags = direction == SPA_DIRECTION_INPUT ? SPA_PORT_FLAG_NO_REF : 0;
+	port->params[PORT_EnumFormat] = SPA_PARAM_INFO(SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
+	port->params[PORT_Format] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+	port->params[PORT_Buffers] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	port->info.params = port->params;
+	port->info.n_params = N_PORT_PARAMS;
+}
+
+static int impl_init(const struct spa_handle_factory *factory,
+                     struct spa_handle *handle,
+                     const struct spa_dict *info,
+                     const struct spa_support *support,
+                     uint32_t n_support)
+{
+	struct loopback *this = (struct loopback *) handle;
+
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	spa_zero(*this);
+
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	this->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
+	this->data_loop = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataLoop);
+	if (this->log == NULL)
+		return -EINVAL;
+
+	this->node.iface = SPA_INTERFACE_INIT(
+		SPA_TYPE_INTERFACE_Node,
+		SPA_VERSION_NODE,
+		&impl_node, this);
+	spa_hook_list_init(&this->hooks);
+
+	this->info_all = SPA_NODE_CHANGE_MASK_FLAGS | SPA_NODE_CHANGE_MASK_PARAMS;
+	this->info = SPA_NODE_INFO_INIT();
+	this->info.max_input_ports = 1;
+	this->info.max_output_ports = 1;
+	this->info.flags = SPA_NODE_FLAG_RT;
+	this->params[0] = SPA_PARAM_INFO(SPA_PARAM_ProcessLatency, SPA_PARAM_INFO_READ);
+	this->info.params = this->params;
+	this->info.n_params = SPA_N_ELEMENTS(this->params);
+
+	init_port(this, SPA_DIRECTION_INPUT);
+	init_port(this, SPA_DIRECTION_OUTPUT);
+
+	this->pending = SPA_ID_INVALID;
+
+	spa_log_info(this->log, "null-loopback %p: initialized", this);
+
+	return 0;
+}
+
+static const struct spa_interface_info impl_interfaces[] = {
+	{SPA_TYPE_INTERFACE_Node,},
+};
+
+static int impl_enum_interface_info(const struct spa_handle_factory *factory,
+                                    const struct spa_interface_info **info,
+                                    uint32_t *index)
+{
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(info != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+
+	switch (*index) {
+	case 0:
+		*info = &impl_interfaces[*index];
+		break;
+	default:
+		return 0;
+	}
+	(*index)++;
+	return 1;
+}
+
+/**
+ * @brief Null loopback factory definition
+ *
+ * Creates nodes that consume audio like the null sink and publish it on
+ * an output port one quantum later, copied into the output pool.
+ */
+const struct spa_handle_factory spa_null_loopback_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	.name = SPA_NAME_API_NULL_LOOPBACK,
+	.get_size = impl_get_size,
+	.init = impl_init,
+	.enum_interface_info = impl_enum_interface_info,
+};
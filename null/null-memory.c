@@ -0,0 +1,168 @@
+/* SPA Null Sink RT Memory Residency */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-memory.c
+ * @brief SPA Null Sink - Lock and prefault memory touched by process()
+ *
+ * A page fault in the data loop costs anywhere from a microsecond (minor
+ * fault on a zero page) to milliseconds (major fault, or reclaim under
+ * memory pressure), and shows up as a sporadic latency outlier that is
+ * hard to tell apart from scheduling noise.
+ *
+ * With the null.mlock property, SPA_NODE_COMMAND_Start makes every page
+ * impl_node_process() can touch resident before the first cycle:
+ *
+ *   - the null_state itself, which holds all counters and statistics
+ *   - the readable memory of every buffer from use_buffers
+ *   - the perf_event user pages read by rdpmc (null.perf)
+ *   - the shared-memory stats segment (null.shm)
+ *
+ * RESIDENCY STEPS:
+ * ===============
+ * 1. mlock() the range, so it is faulted in and never paged out. This
+ *    needs CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK; when it fails
+ *    the sink warns and falls back to prefaulting only.
+ * 2. Touch every page: writable memory is written back with its own
+ *    contents, so private pages are not left mapped to the shared zero
+ *    page and the first real write does not fault. Buffer memory is
+ *    only read.
+ *
+ * WHAT IS LOCKED:
+ * ==============
+ * Page locks don't nest: one munlock() unlocks a page however often it
+ * was locked. Only mappings the sink created itself are therefore
+ * locked, the MemFd buffers it mapped in use_buffers and the stats
+ * segment, as those pages belong to nobody else. The null_state lives
+ * in the handle memory of the host and MemPtr buffers in host
+ * allocations, so their pages may be shared with other handles or
+ * locked by the host: they are only prefaulted, and never unlocked.
+ *
+ * Buffers set while started are made resident in use_buffers. The
+ * grouped aggregator tables are shared between sinks and reallocated on
+ * join, so they are not covered.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "null.h"
+#include "null-shm.h"
+
+static void prefault(void *data, size_t size, bool write)
+{
+	volatile uint8_t *p = data;
+	size_t i, page_size = sysconf(_SC_PAGESIZE);
+	uint8_t sum = 0;
+
+	if (p == NULL || size == 0)
+		return;
+
+	for (i = 0; i < size; i += page_size) {
+		if (write)
+			p[i] = p[i];
+		else
+			sum += p[i];
+	}
+	if (write)
+		p[size - 1] = p[size - 1];
+	else
+		sum += p[size - 1];
+
+	(void) sum;
+}
+
+static int lock_range(struct null_state *state, void *data, size_t size, bool write)
+{
+	int res = 0;
+
+	if (data == NULL || size == 0)
+		return 0;
+
+	if (mlock(data, size) < 0)
+		res = -errno;
+
+	prefault(data, size, write);
+
+	return res;
+}
+
+int null_memory_lock_buffers(struct null_state *state)
+{
+	uint32_t i;
+	int res, err = 0;
+
+	for (i = 0; i < state->n_buffers; i++) {
+		struct spa_buffer *buf = state->buffers[i];
+		struct null_mem *m = &state->mems[i];
+
+		if (buf == NULL || m->data == NULL)
+			continue;
+
+		if (m->map != NULL) {
+			if ((res = lock_range(state, m->map, m->map_size, false)) < 0)
+				err = res;
+		} else {
+			prefault(m->data, buf->datas[0].maxsize, false);
+		}
+	}
+	return err;
+}
+
+int null_memory_lock(struct null_state *state)
+{
+	uint32_t i;
+	int res, err = 0;
+
+	if (state->locked)
+		return 0;
+
+	/* Host memory, see WHAT IS LOCKED */
+	prefault(state, sizeof(*state), true);
+
+	if ((res = null_memory_lock_buffers(state)) < 0)
+		err = res;
+
+	/* The stats segment is written every cycle */
+	if (state->shm != NULL &&
+	    (res = lock_range(state, state->shm, sizeof(struct null_shm_segment), true)) < 0)
+		err = res;
+
+	/* perf_event user pages can't be locked, but are read every cycle */
+	for (i = 0; state->perf.open && i < NULL_PERF_COUNTERS; i++)
+		prefault(state->perf.counters[i].page, 1, false);
+
+	state->locked = err == 0;
+
+	if (err < 0)
+		spa_log_warn(state->log, "null-sink %p: can't lock memory, prefaulted only: %s",
+			     state, spa_strerror(err));
+	else
+		spa_log_debug(state->log, "null-sink %p: prefaulted %zu bytes of state, "
+			      "locked own mappings of %u buffers", state, sizeof(*state),
+			      state->n_buffers);
+
+	return err;
+}
+
+void null_memory_unlock(struct null_state *state)
+{
+	uint32_t i;
+
+	/*
+	 * Also after a partly failed lock: unlocking an unlocked page of
+	 * an own mapping is harmless, host memory is never unlocked.
+	 */
+	for (i = 0; i < state->n_buffers; i++) {
+		struct null_mem *m = &state->mems[i];
+
+		if (m->map != NULL)
+			munlock(m->map, m->map_size);
+	}
+	if (state->shm != NULL)
+		munlock(state->shm, sizeof(struct null_shm_segment));
+
+	state->locked = false;
+}
@@ -0,0 +1,1287 @@
+/* SPA Null Mix Sink */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-mix.c
+ * @brief SPA Null Mix Sink - Multi-input null sink with one mixdown accumulator
+ *
+ * The mix sink takes any number of audio inputs and sums them into one
+ * internal accumulator every cycle, then drops the mix or meters it. It
+ * is a terminal for conference-style graphs that only need a level for
+ * the whole room, without a mixer node in front of a sink, and a
+ * benchmark of what mixing costs per input stream.
+ *
+ * PORTS:
+ * =====
+ * Input ports are dynamic: the host adds one per link with add_port(),
+ * up to MIX_MAX_PORTS. All inputs share one F32 or F32P format, the
+ * first port to get a Format sets it and the others have to match.
+ *
+ * ACCUMULATOR:
+ * ===========
+ * One plane of MIX_MAX_FRAMES samples per channel (planar) or one
+ * interleaved plane, allocated 64-byte aligned when the format is set
+ * so process() never allocates. Per cycle and plane, the first input is
+ * copied in and every further one added with the vector kernel picked
+ * from the CPU flags at init:
+ *
+ *   avx   8 floats per instruction, when the CPU and OS support it
+ *   sse   4 floats per instruction
+ *   c     scalar, also forced with null.mix.simd=false to compare
+ *
+ * Inputs shorter than the mix so far only add over their own length.
+ *
+ * METER:
+ * =====
+ * With null.mix.meter (default true) the mix is analyzed after summing:
+ * peak and RMS of the cycle across all planes, readable through Props
+ * as null.mix.peak and null.mix.rms (linear full scale). The meter can
+ * be toggled at runtime through Props.
+ *
+ * Pause logs the cycles, inputs mixed and the time spent mixing per
+ * cycle and per input buffer.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <spa/support/cpu.h>
+#include <spa/support/system.h>
+#include <spa/utils/result.h>
+#include <spa/utils/string.h>
+#include <spa/buffer/buffer.h>
+#include <spa/param/buffers.h>
+#include <spa/param/props.h>
+#include <spa/pod/builder.h>
+#include <spa/pod/filter.h>
+#include <spa/pod/parser.h>
+#include <spa/param/audio/format-utils.h>
+
+#include "null.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIX_X86 1
+#else
+#define MIX_X86 0
+#endif
+
+/** Most inputs one mix sink takes */
+#define MIX_MAX_PORTS		64
+
+/** Frames per plane in the accumulator, larger buffers are cut */
+#define MIX_MAX_FRAMES		8192
+
+/** Accumulator alignment, covers AVX loads and a cache line */
+#define MIX_ALIGN		64
+
+#define CHECK_PORT(this,d,p)	((d) == SPA_DIRECTION_INPUT && (p) < MIX_MAX_PORTS && \
+				 (this)->ports[p].valid)
+
+enum {
+	PORT_EnumFormat,
+	PORT_Format,
+	PORT_Buffers,
+	N_PORT_PARAMS,
+};
+
+enum {
+	NODE_PropInfo,
+	NODE_Props,
+	N_NODE_PARAMS,
+};
+
+/*
+ * MIX KERNELS:
+ * ===========
+ * add() sums src into dst, dst is the accumulator and always aligned to
+ * MIX_ALIGN, src is buffer memory and may not be. meter() folds the
+ * peak and the sum of squares of an aligned run into *peak and *sum.
+ */
+
+struct mix_ops {
+	const char *name;
+	uint32_t cpu_flags;
+	void (*add) (float * SPA_RESTRICT dst, const float * SPA_RESTRICT src, uint32_t n);
+	void (*meter) (const float * SPA_RESTRICT src, uint32_t n, float *peak, float *sum);
+};
+
+static void add_c(float * SPA_RESTRICT dst, const float * SPA_RESTRICT src, uint32_t n)
+{
+	uint32_t i;
+
+	for (i = 0; i < n; i++)
+		dst[i] += src[i];
+}
+
+static void meter_c(const float * SPA_RESTRICT src, uint32_t n, float *peak, float *sum)
+{
+	float p = *peak, s = *sum;
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		p = fmaxf(p, fabsf(src[i]));
+		s += src[i] * src[i];
+	}
+	*peak = p;
+	*sum = s;
+}
+
+#if MIX_X86
+__attribute__((target("sse")))
+static void add_sse(float * SPA_RESTRICT dst, const float * SPA_RESTRICT src, uint32_t n)
+{
+	uint32_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128 a0 = _mm_add_ps(_mm_load_ps(dst + i), _mm_loadu_ps(src + i));
+		__m128 a1 = _mm_add_ps(_mm_load_ps(dst + i + 4), _mm_loadu_ps(src + i + 4));
+		_mm_store_ps(dst + i, a0);
+		_mm_store_ps(dst + i + 4, a1);
+	}
+	for (; i < n; i++)
+		dst[i] += src[i];
+}
+
+__attribute__((target("sse")))
+static void meter_sse(const float * SPA_RESTRICT src, uint32_t n, float *peak, float *sum)
+{
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	__m128 p = _mm_setzero_ps(), s = _mm_setzero_ps();
+	float vp[4], vs[4];
+	uint32_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 v = _mm_load_ps(src + i);
+		p = _mm_max_ps(p, _mm_andnot_ps(sign, v));
+		s = _mm_add_ps(s, _mm_mul_ps(v, v));
+	}
+	_mm_storeu_ps(vp, p);
+	_mm_storeu_ps(vs, s);
+	*peak = fmaxf(*peak, fmaxf(fmaxf(vp[0], vp[1]), fmaxf(vp[2], vp[3])));
+	*sum += (vs[0] + vs[1]) + (vs[2] + vs[3]);
+
+	meter_c(src + i, n - i, peak, sum);
+}
+
+__attribute__((target("avx")))
+static void add_avx(float * SPA_RESTRICT dst, const float * SPA_RESTRICT src, uint32_t n)
+{
+	uint32_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m256 a0 = _mm256_add_ps(_mm256_load_ps(dst + i), _mm256_loadu_ps(src + i));
+		__m256 a1 = _mm256_add_ps(_mm256_load_ps(dst + i + 8), _mm256_loadu_ps(src + i + 8));
+		_mm256_store_ps(dst + i, a0);
+		_mm256_store_ps(dst + i + 8, a1);
+	}
+	for (; i < n; i++)
+		dst[i] += src[i];
+}
+
+__attribute__((target("avx")))
+static void meter_avx(const float * SPA_RESTRICT src, uint32_t n, float *peak, float *sum)
+{
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	__m256 p = _mm256_setzero_ps(), s = _mm256_setzero_ps();
+	float vp[8], vs[8];
+	uint32_t i = 0, j;
+
+	for (; i + 8 <= n; i += 8) {
+		__m256 v = _mm256_load_ps(src + i);
+		p = _mm256_max_ps(p, _mm256_andnot_ps(sign, v));
+		s = _mm256_add_ps(s, _mm256_mul_ps(v, v));
+	}
+	_mm256_storeu_ps(vp, p);
+	_mm256_storeu_ps(vs, s);
+	for (j = 0; j < 8; j++) {
+		*peak = fmaxf(*peak, vp[j]);
+		*sum += vs[j];
+	}
+
+	meter_c(src + i, n - i, peak, sum);
+}
+#endif
+
+/** Best first, the first one whose flags the CPU has is used */
+static const struct mix_ops mix_ops_table[] = {
+#if MIX_X86
+	{ "avx", SPA_CPU_FLAG_AVX, add_avx, meter_avx },
+	{ "sse", SPA_CPU_FLAG_SSE, add_sse, meter_sse },
+#endif
+	{ "c", 0, add_c, meter_c },
+};
+
+static const struct mix_ops *find_ops(uint32_t cpu_flags)
+{
+	uint32_t i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(mix_ops_table); i++) {
+		if ((mix_ops_table[i].cpu_flags & cpu_flags) == mix_ops_table[i].cpu_flags)
+			return &mix_ops_table[i];
+	}
+	return &mix_ops_table[SPA_N_ELEMENTS(mix_ops_table) - 1];
+}
+
+/*
+ * STATE:
+ * =====
+ */
+
+struct mix_port {
+	bool valid;
+	bool have_format;
+
+	uint64_t info_all;
+	struct spa_port_info info;
+	struct spa_param_info params[N_PORT_PARAMS];
+
+	struct spa_io_buffers *io;
+	struct spa_buffer *buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+};
+
+/** What process() reads besides the ports, swapped on the data loop */
+struct mix_rt {
+	float *accum;                 /**< n_planes * plane_samples floats */
+	uint32_t n_planes;
+	uint32_t plane_samples;
+	const struct mix_ops *ops;
+	bool started;
+	bool meter;
+};
+
+struct mix {
+	struct spa_handle handle;
+	struct spa_node node;
+
+	struct spa_log *log;
+	struct spa_loop *data_loop;
+	struct spa_system *data_system;
+	struct spa_hook_list hooks;
+
+	uint64_t info_all;
+	struct spa_node_info info;
+	struct spa_param_info params[N_NODE_PARAMS];
+
+	struct mix_port ports[MIX_MAX_PORTS];
+	uint32_t n_formats;           /**< Ports with a format */
+
+	bool have_format;
+	struct spa_audio_info_raw format;
+	uint32_t stride;              /**< Bytes per frame of one plane */
+
+	/* Data loop state, changed by the control plane only through invoke */
+	struct mix_rt rt;
+	struct mix_port *mix[MIX_MAX_PORTS];  /**< Ports with format, io and buffers */
+	uint32_t n_mix;
+
+	/* Written by process() */
+	float peak;                   /**< Peak of the last cycle */
+	float rms;                    /**< RMS of the last cycle */
+	float peak_max;               /**< Highest peak since Start */
+	uint64_t cycle_count;         /**< Cycles with at least one input */
+	uint64_t idle_count;          /**< Cycles without any input */
+	uint64_t input_count;         /**< Input buffers mixed */
+	uint64_t sample_count;        /**< Samples added to the accumulator */
+	uint64_t mix_ns;              /**< Time spent mixing and metering */
+};
+
+/*
+ * PROCESSING:
+ * ==========
+ */
+
+static inline uint64_t get_time(struct mix *this)
+{
+	struct timespec now;
+
+	if (this->data_system == NULL)
+		return 0;
+	spa_system_clock_gettime(this->data_system, CLOCK_MONOTONIC, &now);
+	return SPA_TIMESPEC_TO_NSEC(&now);
+}
+
+/** Add one input plane to the accumulator plane, copy where it is still empty */
+static inline uint32_t mix_plane(const struct mix_rt *rt, float *dst, uint32_t filled,
+                                 const struct spa_data *d)
+{
+	const float *src;
+	uint32_t offset, size, n;
+
+	/* The data of every plane is checked in use_buffers() */
+	if (d->chunk == NULL)
+		return filled;
+
+	offset = SPA_MIN(d->chunk->offset, d->maxsize);
+	size = SPA_MIN(d->chunk->size, d->maxsize - offset);
+	n = SPA_MIN(size / (uint32_t) sizeof(float), rt->plane_samples);
+	src = SPA_PTROFF(d->data, offset, const float);
+
+	rt->ops->add(dst, src, SPA_MIN(n, filled));
+	if (n > filled)
+		memcpy(dst + filled, src + filled, (n - filled) * sizeof(float));
+
+	return SPA_MAX(n, filled);
+}
+
+static int impl_node_process(void *object)
+{
+	struct mix *this = object;
+	const struct mix_rt *rt = &this->rt;
+	uint32_t filled[NULL_AUDIO_MAX_CHANNELS];
+	uint32_t i, j, n_inputs = 0;
+	uint64_t start, samples = 0;
+	float peak = 0.0f, sum = 0.0f;
+
+	if (spa_unlikely(!rt->started || rt->accum == NULL))
+		return SPA_STATUS_OK;
+
+	start = get_time(this);
+	memset(filled, 0, rt->n_planes * sizeof(uint32_t));
+
+	for (i = 0; i < this->n_mix; i++) {
+		struct mix_port *port = this->mix[i];
+		struct spa_io_buffers *io = port->io;
+		struct spa_buffer *buf;
+		uint32_t n_planes;
+
+		if (io->status != SPA_STATUS_HAVE_DATA)
+			continue;
+		io->status = SPA_STATUS_NEED_DATA;
+		if (spa_unlikely(io->buffer_id >= port->n_buffers))
+			continue;
+
+		buf = port->buffers[io->buffer_id];
+		n_planes = SPA_MIN(rt->n_planes, buf->n_datas);
+		for (j = 0; j < n_planes; j++)
+			filled[j] = mix_plane(rt, rt->accum + j * rt->plane_samples,
+					      filled[j], &buf->datas[j]);
+		n_inputs++;
+	}
+
+	if (n_inputs == 0) {
+		this->idle_count++;
+		return SPA_STATUS_NEED_DATA;
+	}
+
+	for (j = 0; j < rt->n_planes; j++)
+		samples += filled[j];
+
+	/* Analyze the mix, or drop it */
+	if (rt->meter) {
+		for (j = 0; j < rt->n_planes; j++)
+			rt->ops->meter(rt->accum + j * rt->plane_samples, filled[j], &peak, &sum);
+		this->peak = peak;
+		this->rms = samples ? sqrtf(sum / samples) : 0.0f;
+		this->peak_max = fmaxf(this->peak_max, peak);
+	}
+
+	this->cycle_count++;
+	this->input_count += n_inputs;
+	this->sample_count += samples;
+	this->mix_ns += get_time(this) - start;
+
+	return SPA_STATUS_NEED_DATA;
+}
+
+/*
+ * DATA LOOP STATE:
+ * ===============
+ * The rt config and the list of mixed ports are read by process(), so
+ * they are written on the data loop with a blocking invoke, like the
+ * null sink swaps its config. A port leaves the list before its io or
+ * buffers change and joins it again once it has all three.
+ */
+
+static int do_apply(struct spa_loop *loop, bool async, uint32_t seq,
+                    const void *data, size_t size, void *user_data)
+{
+	struct mix *this = user_data;
+
+	this->rt = *(const struct mix_rt *) data;
+	return 0;
+}
+
+static void apply(struct mix *this, const struct mix_rt *rt)
+{
+	if (this->data_loop != NULL)
+		spa_loop_invoke(this->data_loop, do_apply, 0, rt, sizeof(*rt), true, this);
+	else
+		do_apply(NULL, false, 0, rt, sizeof(*rt), this);
+}
+
+struct port_update {
+	struct mix_port *port;
+	bool active;
+};
+
+static int do_port_update(struct spa_loop *loop, bool async, uint32_t seq,
+                          const void *data, size_t size, void *user_data)
+{
+	struct mix *this = user_data;
+	const struct port_update *u = data;
+	uint32_t i;
+
+	for (i = 0; i < this->n_mix; i++) {
+		if (this->mix[i] == u->port)
+			break;
+	}
+	if (u->active && i == this->n_mix)
+		this->mix[this->n_mix++] = u->port;
+	else if (!u->active && i < this->n_mix)
+		this->mix[i] = this->mix[--this->n_mix];
+	return 0;
+}
+
+static void port_update(struct mix *this, struct mix_port *port, bool active)
+{
+	struct port_update u = { .port = port, .active = active };
+
+	if (this->data_loop != NULL)
+		spa_loop_invoke(this->data_loop, do_port_update, 0, &u, sizeof(u), true, this);
+	else
+		do_port_update(NULL, false, 0, &u, sizeof(u), this);
+}
+
+/** Join the mix when the port has everything process() needs */
+static void port_activate(struct mix *this, struct mix_port *port)
+{
+	if (port->valid && port->have_format && port->io != NULL && port->n_buffers > 0)
+		port_update(this, port, true);
+}
+
+/*
+ * INFO:
+ * ====
+ */
+
+static void emit_node_info(struct mix *this, bool full)
+{
+	uint64_t old = full ? this->info.change_mask : 0;
+	uint32_t i;
+
+	if (full)
+		this->info.change_mask = this->info_all;
+	if (this->info.change_mask == 0)
+		return;
+
+	if (this->info.change_mask & SPA_NODE_CHANGE_MASK_PARAMS) {
+		for (i = 0; i < this->info.n_params; i++) {
+			if (this->params[i].user > 0) {
+				this->params[i].flags ^= SPA_PARAM_INFO_SERIAL;
+				this->params[i].user = 0;
+			}
+		}
+	}
+	spa_node_emit_info(&this->hooks, &this->info);
+	this->info.change_mask = old;
+}
+
+static void emit_port_info(struct mix *this, uint32_t port_id, bool full)
+{
+	struct mix_port *port = &this->ports[port_id];
+	uint64_t old = full ? port->info.change_mask : 0;
+	uint32_t i;
+
+	if (full)
+		port->info.change_mask = port->info_all;
+	if (port->info.change_mask == 0)
+		return;
+
+	if (port->info.change_mask & SPA_PORT_CHANGE_MASK_PARAMS) {
+		for (i = 0; i < port->info.n_params; i++) {
+			if (port->params[i].user > 0) {
+				port->params[i].flags ^= SPA_PARAM_INFO_SERIAL;
+				port->params[i].user = 0;
+			}
+		}
+	}
+	spa_node_emit_port_info(&this->hooks, SPA_DIRECTION_INPUT, port_id, &port->info);
+	port->info.change_mask = old;
+}
+
+static int impl_node_add_listener(void *object,
+                                  struct spa_hook *listener,
+                                  const struct spa_node_events *events,
+                                  void *data)
+{
+	struct mix *this = object;
+	struct spa_hook_list save;
+	uint32_t i;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	spa_hook_list_isolate(&this->hooks, &save, listener, events, data);
+
+	emit_node_info(this, true);
+	for (i = 0; i < MIX_MAX_PORTS; i++) {
+		if (this->ports[i].valid)
+			emit_port_info(this, i, true);
+	}
+
+	spa_hook_list_join(&this->hooks, &save);
+
+	return 0;
+}
+
+static int impl_node_sync(void *object, int seq)
+{
+	struct mix *this = object;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	spa_node_emit_result(&this->hooks, seq, 0, 0, NULL);
+
+	return 0;
+}
+
+/*
+ * NODE METHODS:
+ * ============
+ */
+
+static int impl_node_enum_params(void *object, int seq,
+                                 uint32_t id, uint32_t start, uint32_t num,
+                                 const struct spa_pod *filter)
+{
+	struct mix *this = object;
+	struct spa_pod *param;
+	struct spa_pod_builder b = { 0 };
+	struct spa_pod_frame f[2];
+	uint8_t buffer[1024];
+	struct spa_result_node_params result;
+	uint32_t count = 0;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(num != 0, -EINVAL);
+
+	result.id = id;
+	result.next = start;
+
+next:
+	result.index = result.next++;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (id) {
+	case SPA_PARAM_PropInfo:
+		switch (result.index) {
+		case 0:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_PropInfo, id,
+				SPA_PROP_INFO_name, SPA_POD_String(NULL_KEY_MIX_METER),
+				SPA_PROP_INFO_description, SPA_POD_String("Meter the mix"),
+				SPA_PROP_INFO_type, SPA_POD_CHOICE_Bool(this->rt.meter),
+				SPA_PROP_INFO_params, SPA_POD_Bool(true));
+			break;
+		case 1:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_PropInfo, id,
+				SPA_PROP_INFO_name, SPA_POD_String(NULL_KEY_MIX_PEAK),
+				SPA_PROP_INFO_description, SPA_POD_String("Peak of the last cycle (read-only)"),
+				SPA_PROP_INFO_type, SPA_POD_Float(this->peak),
+				SPA_PROP_INFO_params, SPA_POD_Bool(true));
+			break;
+		case 2:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_PropInfo, id,
+				SPA_PROP_INFO_name, SPA_POD_String(NULL_KEY_MIX_RMS),
+				SPA_PROP_INFO_description, SPA_POD_String("RMS of the last cycle (read-only)"),
+				SPA_PROP_INFO_type, SPA_POD_Float(this->rms),
+				SPA_PROP_INFO_params, SPA_POD_Bool(true));
+			break;
+		default:
+			return 0;
+		}
+		break;
+
+	case SPA_PARAM_Props:
+		/* The levels are written by process(), a read sees the latest cycle */
+		if (result.index > 0)
+			return 0;
+		spa_pod_builder_push_object(&b, &f[0], SPA_TYPE_OBJECT_Props, id);
+		spa_pod_builder_prop(&b, SPA_PROP_params, 0);
+		spa_pod_builder_push_struct(&b, &f[1]);
+		spa_pod_builder_string(&b, NULL_KEY_MIX_METER);
+		spa_pod_builder_bool(&b, this->rt.meter);
+		spa_pod_builder_string(&b, NULL_KEY_MIX_PEAK);
+		spa_pod_builder_float(&b, this->peak);
+		spa_pod_builder_string(&b, NULL_KEY_MIX_RMS);
+		spa_pod_builder_float(&b, this->rms);
+		spa_pod_builder_pop(&b, &f[1]);
+		param = spa_pod_builder_pop(&b, &f[0]);
+		break;
+
+	default:
+		return 0;
+	}
+
+	if (spa_pod_filter(&b, &result.param, param, filter) < 0)
+		goto next;
+
+	spa_node_emit_result(&this->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
+
+	if (++count != num)
+		goto next;
+
+	return 0;
+}
+
+static void set_meter(struct mix *this, bool meter)
+{
+	struct mix_rt rt = this->rt;
+
+	if (rt.meter == meter)
+		return;
+
+	rt.meter = meter;
+	apply(this, &rt);
+	this->peak = this->rms = 0.0f;
+
+	this->params[NODE_Props].user++;
+	this->info.change_mask |= SPA_NODE_CHANGE_MASK_PARAMS;
+	emit_node_info(this, false);
+}
+
+static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
+                               const struct spa_pod *param)
+{
+	struct mix *this = object;
+	struct spa_pod *params = NULL;
+	struct spa_pod_parser prs;
+	struct spa_pod_frame f;
+	int res;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	if (id != SPA_PARAM_Props)
+		return -ENOTSUP;
+	if (param == NULL)
+		return 0;
+
+	if ((res = spa_pod_parse_object(param,
+			SPA_TYPE_OBJECT_Props, NULL,
+			SPA_PROP_params, SPA_POD_OPT_Pod(&params))) < 0)
+		return res;
+	if (params == NULL)
+		return 0;
+
+	spa_pod_parser_pod(&prs, params);
+	if (spa_pod_parser_push_struct(&prs, &f) < 0)
+		return -EINVAL;
+
+	while (true) {
+		const char *name;
+		struct spa_pod *pod;
+		bool b;
+
+		if (spa_pod_parser_get_string(&prs, &name) < 0 ||
+		    spa_pod_parser_get_pod(&prs, &pod) < 0)
+			break;
+
+		/* The levels are read-only and ignored */
+		if (spa_streq(name, NULL_KEY_MIX_METER) && spa_pod_get_bool(pod, &b) >= 0)
+			set_meter(this, b);
+	}
+	return 0;
+}
+
+static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
+{
+	switch (id) {
+	case SPA_IO_Position:
+	case SPA_IO_Clock:
+		/* The mix follows the inputs, not the quantum */
+		return 0;
+	default:
+		return -ENOENT;
+	}
+}
+
+static void set_started(struct mix *this, bool started)
+{
+	struct mix_rt rt = this->rt;
+
+	rt.started = started;
+	apply(this, &rt);
+}
+
+static void log_stats(struct mix *this)
+{
+	if (this->cycle_count == 0)
+		return;
+
+	spa_log_info(this->log, "null-mix %p: mixed %" PRIu64 " inputs in %" PRIu64
+		     " cycles (%" PRIu64 " idle), %" PRIu64 " samples with %s",
+		     this, this->input_count, this->cycle_count, this->idle_count,
+		     this->sample_count, this->rt.ops->name);
+	spa_log_info(this->log, "null-mix %p: %" PRIu64 " ns per cycle, %" PRIu64
+		     " ns per input, peak %.3f", this,
+		     this->mix_ns / this->cycle_count,
+		     this->mix_ns / SPA_MAX(this->input_count, 1u), this->peak_max);
+}
+
+static int impl_node_send_command(void *object, const struct spa_command *command)
+{
+	struct mix *this = object;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(command != NULL, -EINVAL);
+
+	switch (SPA_NODE_COMMAND_ID(command)) {
+	case SPA_NODE_COMMAND_Start:
+		/* Inputs come and go, starting without any is fine */
+		this->peak_max = 0.0f;
+		set_started(this, true);
+		spa_log_info(this->log, "null-mix %p: started with %u inputs, %s kernels",
+			     this, this->n_mix, this->rt.ops->name);
+		break;
+
+	case SPA_NODE_COMMAND_Suspend:
+	case SPA_NODE_COMMAND_Pause:
+		/* After the invoke process() is idle, the counters are final */
+		set_started(this, false);
+		log_stats(this);
+		break;
+
+	case SPA_NODE_COMMAND_Flush:
+		/* The accumulator only lives for one cycle, nothing is queued */
+		break;
+
+	default:
+		return -ENOTSUP;
+	}
+	return 0;
+}
+
+/*
+ * PORT METHODS:
+ * ============
+ */
+
+static void init_port(struct mix *this, uint32_t port_id)
+{
+	struct mix_port *port = &this->ports[port_id];
+
+	spa_zero(*port);
+	port->valid = true;
+	port->info_all = SPA_PORT_CHANGE_MASK_FLAGS | SPA_PORT_CHANGE_MASK_PARAMS;
+	port->info = SPA_PORT_INFO_INIT();
+	/* Input is summed within the cycle, no buffer is kept */
+	port->info.flags = SPA_PORT_FLAG_NO_REF;
+	port->params[PORT_EnumFormat] = SPA_PARAM_INFO(SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
+	port->params[PORT_Format] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+	port->params[PORT_Buffers] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	port->info.params = port->params;
+	port->info.n_params = N_PORT_PARAMS;
+}
+
+static int impl_node_add_port(void *object, enum spa_direction direction, uint32_t port_id,
+                              const struct spa_dict *props)
+{
+	struct mix *this = object;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	if (direction != SPA_DIRECTION_INPUT || port_id >= MIX_MAX_PORTS)
+		return -EINVAL;
+	if (this->ports[port_id].valid)
+		return -EEXIST;
+
+	init_port(this, port_id);
+	emit_port_info(this, port_id, true);
+
+	spa_log_debug(this->log, "null-mix %p: added input %u", this, port_id);
+	return 0;
+}
+
+/** Drop the node format and accumulator once no port has a format */
+static void release_format(struct mix *this)
+{
+	struct mix_rt rt = this->rt;
+	float *accum = rt.accum;
+
+	rt.accum = NULL;
+	rt.n_planes = rt.plane_samples = 0;
+	apply(this, &rt);
+	free(accum);
+
+	this->have_format = false;
+	this->stride = 0;
+}
+
+/** Stop mixing a port and drop its buffers and format */
+static void clear_port(struct mix *this, struct mix_port *port)
+{
+	uint32_t i;
+
+	port_update(this, port, false);
+
+	for (i = 0; i < port->n_buffers; i++)
+		port->buffers[i] = NULL;
+	port->n_buffers = 0;
+
+	if (port->have_format) {
+		port->have_format = false;
+		if (--this->n_formats == 0)
+			release_format(this);
+	}
+}
+
+static int impl_node_remove_port(void *object, enum spa_direction direction, uint32_t port_id)
+{
+	struct mix *this = object;
+	struct mix_port *port;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	if (!CHECK_PORT(this, direction, port_id))
+		return -EINVAL;
+
+	port = &this->ports[port_id];
+	clear_port(this, port);
+	port->io = NULL;
+	port->valid = false;
+
+	spa_node_emit_port_info(&this->hooks, direction, port_id, NULL);
+
+	spa_log_debug(this->log, "null-mix %p: removed input %u", this, port_id);
+	return 0;
+}
+
+static int impl_node_port_enum_params(void *object, int seq,
+                                      enum spa_direction direction, uint32_t port_id,
+                                      uint32_t id, uint32_t start, uint32_t num,
+                                      const struct spa_pod *filter)
+{
+	struct mix *this = object;
+	struct mix_port *port;
+	struct spa_pod *param;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_result_node_params result;
+	uint32_t count = 0, blocks;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(num != 0, -EINVAL);
+
+	if (!CHECK_PORT(this, direction, port_id))
+		return -EINVAL;
+
+	port = &this->ports[port_id];
+
+	result.id = id;
+	result.next = start;
+
+next:
+	result.index = result.next++;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (id) {
+	case SPA_PARAM_EnumFormat:
+		/* All inputs mix in one format, once set it is the only one */
+		if (result.index > 0)
+			return 0;
+		if (this->have_format)
+			param = spa_format_audio_raw_build(&b, id, &this->format);
+		else
+			param = spa_format_audio_raw_build(&b, id,
+				&SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32P));
+		break;
+
+	case SPA_PARAM_Format:
+		if (!port->have_format || result.index > 0)
+			return 0;
+		param = spa_format_audio_raw_build(&b, id, &this->format);
+		break;
+
+	case SPA_PARAM_Buffers:
+		if (!port->have_format || result.index > 0)
+			return 0;
+
+		blocks = SPA_AUDIO_FORMAT_IS_PLANAR(this->format.format) ?
+			this->format.channels : 1;
+
+		/* Larger buffers would not fit the accumulator */
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_ParamBuffers, id,
+			SPA_PARAM_BUFFERS_buffers,  SPA_POD_CHOICE_RANGE_Int(2, 1, MAX_BUFFERS),
+			SPA_PARAM_BUFFERS_blocks,   SPA_POD_Int(blocks),
+			SPA_PARAM_BUFFERS_size,     SPA_POD_CHOICE_RANGE_Int(
+							DEFAULT_FRAMES * this->stride,
+							this->stride, MIX_MAX_FRAMES * this->stride),
+			SPA_PARAM_BUFFERS_stride,   SPA_POD_Int(this->stride),
+			SPA_PARAM_BUFFERS_dataType, SPA_POD_CHOICE_FLAGS_Int(1 << SPA_DATA_MemPtr));
+		break;
+
+	default:
+		return 0;
+	}
+
+	if (spa_pod_filter(&b, &result.param, param, filter) < 0)
+		goto next;
+
+	spa_node_emit_result(&this->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
+
+	if (++count != num)
+		goto next;
+
+	return 0;
+}
+
+static void port_format_changed(struct mix *this, uint32_t port_id)
+{
+	struct mix_port *port = &this->ports[port_id];
+
+	port->params[PORT_Format].flags = port->have_format ?
+		SPA_PARAM_INFO_READWRITE : SPA_PARAM_INFO_WRITE;
+	port->params[PORT_Format].user++;
+	port->params[PORT_Buffers].flags = port->have_format ? SPA_PARAM_INFO_READ : 0;
+	port->params[PORT_Buffers].user++;
+	port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+	emit_port_info(this, port_id, false);
+}
+
+static bool same_format(const struct spa_audio_info_raw *a, const struct spa_audio_info_raw *b)
+{
+	return a->format == b->format && a->rate == b->rate && a->channels == b->channels;
+}
+
+/** Allocate the accumulator for a new node format and hand it to process() */
+static int set_format(struct mix *this, const struct spa_audio_info_raw *raw)
+{
+	struct mix_rt rt = this->rt;
+	uint32_t n_planes, plane_samples;
+	float *old = rt.accum;
+	void *accum;
+
+	if (SPA_AUDIO_FORMAT_IS_PLANAR(raw->format)) {
+		n_planes = raw->channels;
+		plane_samples = MIX_MAX_FRAMES;
+	} else {
+		n_planes = 1;
+		plane_samples = MIX_MAX_FRAMES * raw->channels;
+	}
+
+	if (posix_memalign(&accum, MIX_ALIGN, (size_t) n_planes * plane_samples * sizeof(float)) != 0)
+		return -ENOMEM;
+
+	rt.accum = accum;
+	rt.n_planes = n_planes;
+	rt.plane_samples = plane_samples;
+	apply(this, &rt);
+	free(old);
+
+	this->format = *raw;
+	this->stride = null_audio_frame_stride(raw);
+	this->have_format = true;
+
+	spa_log_info(this->log, "null-mix %p: format %u channels, %u Hz, %u planes of %u samples",
+		     this, raw->channels, raw->rate, n_planes, plane_samples);
+	return 0;
+}
+
+static int impl_node_port_set_param(void *object,
+                                    enum spa_direction direction, uint32_t port_id,
+                                    uint32_t id, uint32_t flags,
+                                    const struct spa_pod *param)
+{
+	struct mix *this = object;
+	struct mix_port *port;
+	struct spa_audio_info info = { 0 };
+	int res;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	if (!CHECK_PORT(this, direction, port_id))
+		return -EINVAL;
+	if (id != SPA_PARAM_Format)
+		return -ENOTSUP;
+
+	port = &this->ports[port_id];
+
+	if (param == NULL) {
+		clear_port(this, port);
+		goto done;
+	}
+
+	if ((res = spa_format_parse(param, &info.media_type, &info.media_subtype)) < 0)
+		return res;
+	if (info.media_type != SPA_MEDIA_TYPE_audio ||
+	    info.media_subtype != SPA_MEDIA_SUBTYPE_raw)
+		return -EINVAL;
+	if ((res = spa_format_audio_raw_parse(param, &info.info.raw)) < 0)
+		return res;
+
+	/* Same channel and rate bounds as the null sink, NULL_AUDIO_MAX_CHANNELS
+	 * also keeps the per-plane fill table of process() in range */
+	if ((res = null_audio_check_raw(this->log, "null-mix", this, &info.info.raw)) < 0)
+		return res;
+	if (info.info.raw.format != SPA_AUDIO_FORMAT_F32 &&
+	    info.info.raw.format != SPA_AUDIO_FORMAT_F32P) {
+		spa_log_error(this->log, "null-mix %p: only F32 and F32P can be mixed", this);
+		return -EINVAL;
+	}
+
+	/* Other inputs hold the node format, this one has to match it */
+	if (this->n_formats > (port->have_format ? 1u : 0u) &&
+	    !same_format(&this->format, &info.info.raw)) {
+		spa_log_error(this->log, "null-mix %p: input %u format does not match the mix",
+			      this, port_id);
+		return -EINVAL;
+	}
+
+	clear_port(this, port);
+
+	if (!this->have_format || !same_format(&this->format, &info.info.raw)) {
+		if ((res = set_format(this, &info.info.raw)) < 0)
+			return res;
+	}
+
+	port->have_format = true;
+	this->n_formats++;
+done:
+	port_format_changed(this, port_id);
+	return 0;
+}
+
+static int impl_node_port_use_buffers(void *object,
+                                      enum spa_direction direction, uint32_t port_id,
+                                      uint32_t flags,
+                                      struct spa_buffer **buffers, uint32_t n_buffers)
+{
+	struct mix *this = object;
+	struct mix_port *port;
+	uint32_t i, j;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	if (!CHECK_PORT(this, direction, port_id))
+		return -EINVAL;
+	if (n_buffers > MAX_BUFFERS)
+		return -ENOSPC;
+
+	port = &this->ports[port_id];
+	if (n_buffers > 0 && !port->have_format)
+		return -EIO;
+
+	/* process() reads every plane, an unmapped one would mix as silence */
+	for (i = 0; i < n_buffers; i++) {
+		for (j = 0; j < buffers[i]->n_datas; j++) {
+			if (buffers[i]->datas[j].data == NULL) {
+				spa_log_error(this->log, "null-mix %p: input %u buffer %u "
+					      "plane %u has no data", this, port_id, i, j);
+				return -EINVAL;
+			}
+		}
+	}
+
+	/* Stop mixing the old set on the data loop before it goes away */
+	port_update(this, port, false);
+
+	for (i = 0; i < port->n_buffers; i++)
+		port->buffers[i] = NULL;
+	for (i = 0; i < n_buffers; i++)
+		port->buffers[i] = buffers[i];
+	port->n_buffers = n_buffers;
+
+	port_activate(this, port);
+
+	spa_log_debug(this->log, "null-mix %p: input %u using %u buffers", this,
+		      port_id, n_buffers);
+	return 0;
+}
+
+static int impl_node_port_set_io(void *object,
+                                 enum spa_direction direction, uint32_t port_id,
+                                 uint32_t id, void *data, size_t size)
+{
+	struct mix *this = object;
+	struct mix_port *port;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	if (!CHECK_PORT(this, direction, port_id))
+		return -EINVAL;
+	if (id != SPA_IO_Buffers)
+		return -ENOENT;
+
+	port = &this->ports[port_id];
+
+	port_update(this, port, false);
+	port->io = size >= sizeof(struct spa_io_buffers) ? data : NULL;
+	port_activate(this, port);
+	return 0;
+}
+
+static int impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t buffer_id)
+{
+	/* Inputs only, nothing comes back */
+	return -ENOTSUP;
+}
+
+static const struct spa_node_methods impl_node = {
+	SPA_VERSION_NODE_METHODS,
+	.add_listener = impl_node_add_listener,
+	.sync = impl_node_sync,
+	.enum_params = impl_node_enum_params,
+	.set_param = impl_node_set_param,
+	.set_io = impl_node_set_io,
+	.send_command = impl_node_send_command,
+	.add_port = impl_node_add_port,
+	.remove_port = impl_node_remove_port,
+	.port_enum_params = impl_node_port_enum_params,
+	.port_set_param = impl_node_port_set_param,
+	.port_use_buffers = impl_node_port_use_buffers,
+	.port_set_io = impl_node_port_set_io,
+	.port_reuse_buffer = impl_node_port_reuse_buffer,
+	.process = impl_node_process,
+};
+
+/*
+ * FACTORY:
+ * =======
+ */
+
+static int impl_get_interface(struct spa_handle *handle, const char *type, void **interface)
+{
+	struct mix *this;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+	spa_return_val_if_fail(interface != NULL, -EINVAL);
+
+	this = (struct mix *) handle;
+
+	if (!spa_streq(type, SPA_TYPE_INTERFACE_Node))
+		return -ENOENT;
+
+	*interface = &this->node;
+	return 0;
+}
+
+static int impl_clear(struct spa_handle *handle)
+{
+	struct mix *this = (struct mix *) handle;
+
+	free(this->rt.accum);
+	this->rt.accum = NULL;
+	spa_hook_list_clean(&this->hooks);
+	return 0;
+}
+
+static size_t impl_get_size(const struct spa_handle_factory *factory,
+                            const struct spa_dict *info)
+{
+	return sizeof(struct mix);
+}
+
+static int impl_init(const struct spa_handle_factory *factory,
+                     struct spa_handle *handle,
+                     const struct spa_dict *info,
+                     const struct spa_support *support,
+                     uint32_t n_support)
+{
+	struct mix *this = (struct mix *) handle;
+	struct spa_cpu *cpu;
+	uint32_t i, cpu_flags = 0;
+	bool simd = true;
+
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	spa_zero(*this);
+
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	this->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
+	this->data_loop = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataLoop);
+	this->data_system = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataSystem);
+	cpu = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_CPU);
+	if (this->log == NULL)
+		return -EINVAL;
+
+	this->rt.meter = true;
+	for (i = 0; info && i < info->n_items; i++) {
+		const char *k = info->items[i].key;
+		const char *s = info->items[i].value;
+
+		if (spa_streq(k, NULL_KEY_MIX_METER))
+			this->rt.meter = spa_atob(s);
+		else if (spa_streq(k, NULL_KEY_MIX_SIMD))
+			simd = spa_atob(s);
+	}
+
+	if (cpu != NULL)
+		cpu_flags = spa_cpu_get_flags(cpu);
+#if defined(__SSE__)
+	/* Baseline of the build, no need to ask */
+	cpu_flags |= SPA_CPU_FLAG_SSE;
+#endif
+	this->rt.ops = find_ops(simd ? cpu_flags : 0);
+
+	this->node.iface = SPA_INTERFACE_INIT(
+		SPA_TYPE_INTERFACE_Node,
+		SPA_VERSION_NODE,
+		&impl_node, this);
+	spa_hook_list_init(&this->hooks);
+
+	this->info_all = SPA_NODE_CHANGE_MASK_FLAGS | SPA_NODE_CHANGE_MASK_PARAMS;
+	this->info = SPA_NODE_INFO_INIT();
+	this->info.max_input_ports = MIX_MAX_PORTS;
+	this->info.max_output_ports = 0;
+	this->info.flags = SPA_NODE_FLAG_RT | SPA_NODE_FLAG_IN_DYNAMIC_PORTS;
+	this->params[NODE_PropInfo] = SPA_PARAM_INFO(SPA_PARAM_PropInfo, SPA_PARAM_INFO_READ);
+	this->params[NODE_Props] = SPA_PARAM_INFO(SPA_PARAM_Props, SPA_PARAM_INFO_READWRITE);
+	this->info.params = this->params;
+	this->info.n_params = N_NODE_PARAMS;
+
+	spa_log_info(this->log, "null-mix %p: initialized, %s kernels, meter %s", this,
+		     this->rt.ops->name, this->rt.meter ? "on" : "off");
+
+	return 0;
+}
+
+static const struct spa_interface_info impl_interfaces[] = {
+	{SPA_TYPE_INTERFACE_Node,},
+};
+
+static int impl_enum_interface_info(const struct spa_handle_factory *factory,
+                                    const struct spa_interface_info **info,
+                                    uint32_t *index)
+{
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(info != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+
+	switch (*index) {
+	case 0:
+		*info = &impl_interfaces[*index];
+		break;
+	default:
+		return 0;
+	}
+	(*index)++;
+	return 1;
+}
+
+/**
+ * @brief Null mix sink factory definition
+ *
+ * Creates nodes with dynamic audio inputs that are summed into one
+ * accumulator every cycle and then dropped or metered.
+ */
+const struct spa_handle_factory spa_null_mix_sink_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	.name = SPA_NAME_API_NULL_MIX_SINK,
+	.get_size = impl_get_size,
+	.init = impl_init,
+	.enum_interface_info = impl_enum_interface_info,
+};
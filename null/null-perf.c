@@ -0,0 +1,255 @@
+/* SPA Null Sink Hardware Counters */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-perf.c
+ * @brief SPA Null Sink - perf_event counters around the process kernel
+ *
+ * Whole-process profiles can't tell the cost of the sink's own work
+ * (statistics, parsing, sweeps) apart from the rest of the data loop.
+ * With the null.perf property the sink opens its own hardware counters
+ * and measures exactly the process kernel, every cycle:
+ *
+ *   cycles, instructions, cache-misses, branch-misses
+ *
+ * PER-THREAD COUNTERS:
+ * ===================
+ * The counters are opened with perf_event_open(pid=0, cpu=-1) so they
+ * follow the data loop thread, which is why they are opened through
+ * spa_loop_invoke() on the data loop at Start. They count user space
+ * only, which is allowed at perf_event_paranoid <= 2.
+ *
+ * READING WITHOUT SYSCALLS:
+ * ========================
+ * Each counter's first page is mapped. On x86 with cap_user_rdpmc the
+ * counter is read with the rdpmc instruction under the page's seqlock,
+ * which costs tens of cycles instead of a read() syscall. Elsewhere, or
+ * while the counter is not scheduled on the PMU, read() is used.
+ *
+ * MEASUREMENT:
+ * ===========
+ * null_process_select() installs null_perf_process() in front of the
+ * selected kernel, so without null.perf nothing changes on the fast
+ * path. Per-cycle deltas are summed and their range kept; the totals
+ * and IPC are logged on Pause.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "null.h"
+
+static const struct {
+	uint64_t config;
+	const char *name;
+} counter_info[NULL_PERF_COUNTERS] = {
+	{ PERF_COUNT_HW_CPU_CYCLES,       "cycles" },
+	{ PERF_COUNT_HW_INSTRUCTIONS,     "instructions" },
+	{ PERF_COUNT_HW_CACHE_MISSES,     "cache-misses" },
+	{ PERF_COUNT_HW_BRANCH_MISSES,    "branch-misses" },
+};
+
+static int open_counter(struct null_perf_counter *c, uint64_t config)
+{
+	struct perf_event_attr attr;
+	void *page;
+	long page_size = sysconf(_SC_PAGESIZE);
+	int fd;
+
+	spa_zero(attr);
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	/* The user page is optional, without it counters are read() */
+	page = mmap(NULL, page_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	spa_zero(*c);
+	c->fd = fd;
+	c->page = page == MAP_FAILED ? NULL : page;
+	c->min = UINT64_MAX;
+
+	return 0;
+}
+
+static int do_open(struct spa_loop *loop, bool async, uint32_t seq,
+                   const void *data, size_t size, void *user_data)
+{
+	struct null_state *state = user_data;
+	struct null_perf *p = &state->perf;
+	uint32_t i;
+	int res;
+
+	for (i = 0; i < NULL_PERF_COUNTERS; i++) {
+		if ((res = open_counter(&p->counters[i], counter_info[i].config)) < 0)
+			return res;
+	}
+	return 0;
+}
+
+int null_perf_open(struct null_state *state)
+{
+	struct null_perf *p = &state->perf;
+	uint32_t i;
+	int res;
+
+	if (p->open)
+		return 0;
+
+	for (i = 0; i < NULL_PERF_COUNTERS; i++)
+		p->counters[i].fd = -1;
+
+	if (state->data_loop != NULL)
+		res = spa_loop_invoke(state->data_loop, do_open, 0, NULL, 0, true, state);
+	else
+		res = do_open(NULL, false, 0, NULL, 0, state);
+
+	if (res < 0) {
+		spa_log_warn(state->log, "null-sink %p: can't open perf counters: %s",
+			     state, spa_strerror(res));
+		null_perf_close(state);
+		return res;
+	}
+
+	p->samples = 0;
+	p->open = true;
+
+	spa_log_info(state->log, "null-sink %p: perf counters open (rdpmc:%s)", state,
+		     p->counters[0].page &&
+		     ((struct perf_event_mmap_page *) p->counters[0].page)->cap_user_rdpmc ?
+		     "yes" : "no");
+
+	return 0;
+}
+
+void null_perf_close(struct null_state *state)
+{
+	struct null_perf *p = &state->perf;
+	long page_size = sysconf(_SC_PAGESIZE);
+	uint32_t i;
+
+	for (i = 0; i < NULL_PERF_COUNTERS; i++) {
+		struct null_perf_counter *c = &p->counters[i];
+
+		if (c->page != NULL)
+			munmap(c->page, page_size);
+		if (c->fd >= 0)
+			close(c->fd);
+		c->page = NULL;
+		c->fd = -1;
+	}
+	p->open = false;
+}
+
+/*
+ * COUNTER READ:
+ * ============
+ * See the perf_event_mmap_page documentation in linux/perf_event.h for
+ * the self-monitoring protocol implemented here.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t rdpmc(uint32_t counter)
+{
+	uint32_t low, high;
+
+	__asm__ volatile("rdpmc" : "=a" (low), "=d" (high) : "c" (counter));
+	return low | ((uint64_t) high) << 32;
+}
+#endif
+
+static inline uint64_t read_counter(struct null_perf_counter *c)
+{
+	uint64_t count = 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+	volatile struct perf_event_mmap_page *pc = c->page;
+	uint32_t seq, idx, width;
+	int64_t pmc;
+
+	if (spa_likely(pc != NULL && pc->cap_user_rdpmc)) {
+		do {
+			seq = pc->lock;
+			__asm__ volatile("" ::: "memory");
+			idx = pc->index;
+			count = pc->offset;
+			if (spa_likely(idx != 0)) {
+				width = pc->pmc_width;
+				pmc = rdpmc(idx - 1);
+				pmc <<= 64 - width;
+				pmc >>= 64 - width;
+				count += pmc;
+			}
+			__asm__ volatile("" ::: "memory");
+		} while (pc->lock != seq);
+
+		if (spa_likely(idx != 0))
+			return count;
+
+		/* idx 0: not on the PMU right now, let the kernel read it */
+		count = 0;
+	}
+#endif
+	if (read(c->fd, &count, sizeof(count)) != sizeof(count))
+		count = 0;
+
+	return count;
+}
+
+int null_perf_process(struct null_state *state)
+{
+	struct null_perf *p = &state->perf;
+	uint64_t start[NULL_PERF_COUNTERS], delta;
+	uint32_t i;
+	int res;
+
+	for (i = 0; i < NULL_PERF_COUNTERS; i++)
+		start[i] = read_counter(&p->counters[i]);
+
+	res = state->rt.perf_kernel(state);
+
+	for (i = NULL_PERF_COUNTERS; i-- > 0; ) {
+		struct null_perf_counter *c = &p->counters[i];
+
+		delta = read_counter(c) - start[i];
+		c->sum += delta;
+		c->min = SPA_MIN(c->min, delta);
+		c->max = SPA_MAX(c->max, delta);
+	}
+	p->samples++;
+
+	return res;
+}
+
+void null_perf_log(struct null_state *state)
+{
+	struct null_perf *p = &state->perf;
+	struct null_perf_counter *c = p->counters;
+	uint32_t i;
+
+	if (!p->open || p->samples == 0)
+		return;
+
+	spa_log_info(state->log, "null-sink %p: perf over %" PRIu64 " process calls, IPC %.2f, "
+		     "%.3f cache-misses/kinstr", state, p->samples,
+		     c[0].sum ? (double) c[1].sum / c[0].sum : 0.0,
+		     c[1].sum ? 1000.0 * c[2].sum / c[1].sum : 0.0);
+
+	for (i = 0; i < NULL_PERF_COUNTERS; i++) {
+		spa_log_info(state->log, "null-sink %p: perf %s total:%" PRIu64
+			     " avg:%.1f min:%" PRIu64 " max:%" PRIu64, state,
+			     counter_info[i].name, c[i].sum, (double) c[i].sum / p->samples,
+			     c[i].min, c[i].max);
+	}
+}
@@ -0,0 +1,71 @@
+/* SPA Null Sink Static Tracepoints */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-probes.h
+ * @brief SPA Null Sink - USDT probes for perf, bpftrace and SystemTap
+ *
+ * The node methods carry static tracepoints (provider "spa_null") at
+ * entry and exit, so production sinks can be traced without debug logs
+ * or a rebuild:
+ *
+ *   probe                 arguments
+ *   process_entry         state, buffer_id, io status, chunk size
+ *   process_exit          state, result, buffer_count
+ *   set_param_entry       state, param id, pod size
+ *   set_param_exit        state, param id, result, media subtype, format
+ *   send_command_entry    state, command id
+ *   send_command_exit     state, result, started
+ *   use_buffers_entry     state, port id, flags, n_buffers
+ *   use_buffers_exit      state, result
+ *   set_io_entry          state, io id, data, size
+ *   set_io_exit           state, io id, result
+ *
+ * Example:
+ *
+ *   bpftrace -e 'usdt:/path/to/spa-null.so:spa_null:process_entry
+ *                { @size = hist(arg3); }'
+ *
+ * ZERO COST WHEN UNUSED:
+ * =====================
+ * A probe site is a single nop. Each probe also has a SystemTap
+ * semaphore, which tracers increment while attached, and the probe
+ * arguments are only evaluated when it is non-zero. Without sys/sdt.h
+ * at build time (HAVE_SYS_SDT_H undefined) the probes compile to
+ * nothing.
+ */
+
+#ifndef SPA_NULL_PROBES_H
+#define SPA_NULL_PROBES_H
+
+#ifdef HAVE_SYS_SDT_H
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+/** Define the semaphore of probe @p name, once per probe */
+#define NULL_PROBE_DEFINE(name)						\
+	unsigned short spa_null_##name##_semaphore			\
+		__attribute__((unused, section(".probes")))
+
+/** True while a tracer is attached to probe @p name */
+#define NULL_PROBE_ENABLED(name)					\
+	__builtin_expect(spa_null_##name##_semaphore != 0, 0)
+
+/** Fire probe @p name, arguments are evaluated only when enabled */
+#define NULL_PROBE(name, ...)						\
+	do {								\
+		if (NULL_PROBE_ENABLED(name))				\
+			STAP_PROBEV(spa_null, name, __VA_ARGS__);	\
+	} while (0)
+
+#else
+
+#define NULL_PROBE_DEFINE(name)		struct null_probe_##name##_unused
+#define NULL_PROBE_ENABLED(name)	0
+#define NULL_PROBE(name, ...)		do { } while (0)
+
+#endif /* HAVE_SYS_SDT_H */
+
+#endif /* SPA_NULL_PROBES_H */
@@ -0,0 +1,624 @@
+/* SPA Null Sink Process Kernels */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-process.c
+ * @brief SPA Null Sink - Compile-time specialized process kernels
+ *
+ * A generic process function has to re-check the node state, the format
+ * and the enabled features on every cycle, and divide by a frame stride
+ * that is only known at runtime. Since all of those only change on the
+ * control plane, the null sink selects one specialized kernel whenever
+ * they change and impl_node_process() just calls through a pointer.
+ *
+ * KERNEL SELECTION:
+ * ================
+ *   not started / no format  -> process_idle
+ *   stats disabled           -> process_consume (no chunk access at all)
+ *   video sink               -> process_video   (chunk sizes and timing)
+ *   control sink             -> process_control (walks the event sequence)
+ *   encoded audio            -> process_encoded (frame headers only)
+ *   grouped raw audio        -> process_group   (shared aggregator sweep)
+ *   (sample size, channels)  -> process_sNcM    (constant frame stride)
+ *   (sample size, planar)    -> process_sN_planar
+ *   anything else            -> process_generic (stride from state)
+ *
+ * On top of the selected kernel, in this order, come the optional
+ * wrappers null_latency_process() (process latency set and clock
+ * available), null_timing_process() (graph clock available),
+ * null_shm_process() (stats segment mapped) and null_perf_process()
+ * (perf counters open).
+ *
+ * The specialized variants are generated from the NULL_AUDIO_KERNELS
+ * X-macro table so adding a configuration is a one-line change.
+ *
+ * CONFIG SWAP:
+ * ===========
+ * The chain, the format fields, the io area and the buffer table the
+ * kernels read are collected in a struct null_config and swapped into
+ * state->rt on the data loop, so a renegotiation never shows a kernel a
+ * half-written format or a buffer whose memory is being unmapped.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+
+#include <spa/buffer/buffer.h>
+#include <spa/control/control.h>
+#include <spa/pod/iter.h>
+
+#include "null.h"
+
+/*
+ * KERNEL TABLE:
+ * ============
+ * K(sample_size, channels) for interleaved layouts and
+ * P(sample_size) for planar layouts, where only the first plane is
+ * needed to count frames.
+ */
+#define NULL_AUDIO_KERNELS(K, P)	\
+	K(2, 1)				\
+	K(2, 2)				\
+	K(3, 2)				\
+	K(4, 1)				\
+	K(4, 2)				\
+	K(4, 6)				\
+	K(4, 8)				\
+	K(8, 2)				\
+	P(2)				\
+	P(4)				\
+	P(8)
+
+/*
+ * SHARED KERNEL HELPERS:
+ * =====================
+ * Always inlined into each kernel so every variant is a single function
+ * without further calls on the fast path.
+ */
+
+/**
+ * @brief Take the pending buffer from the io area
+ *
+ * @return The buffer to consume, or NULL when there is nothing new. In the
+ *         NULL case the io area has already been handed back if needed.
+ */
+static inline struct spa_buffer *dequeue(struct null_state *state,
+                                         struct spa_io_buffers *io)
+{
+	struct spa_buffer *buf;
+
+	if (spa_unlikely(io == NULL))
+		return NULL;
+
+	if (io->status != SPA_STATUS_HAVE_DATA ||
+	    spa_unlikely(io->buffer_id == SPA_ID_INVALID)) {
+		state->empty_count++;
+		return NULL;
+	}
+
+	if (spa_unlikely(io->buffer_id >= state->rt.n_buffers)) {
+		null_rtlog_push(state, NULL_RTLOG_INVALID_BUFFER_ID,
+				io->buffer_id, state->rt.n_buffers, 0);
+		goto drop;
+	}
+
+	buf = state->rt.buffers[io->buffer_id];
+	if (spa_unlikely(buf == NULL)) {
+		null_rtlog_push(state, NULL_RTLOG_NULL_BUFFER, io->buffer_id, 0, 0);
+		goto drop;
+	}
+	return buf;
+
+drop:
+	io->buffer_id = SPA_ID_INVALID;
+	io->status = SPA_STATUS_NEED_DATA;
+	return NULL;
+}
+
+/**
+ * @brief Hand the io area back to the peer after consuming its buffer
+ */
+static inline int consume(struct spa_io_buffers *io)
+{
+	io->buffer_id = SPA_ID_INVALID;
+	io->status = SPA_STATUS_NEED_DATA;
+	return SPA_STATUS_HAVE_DATA;
+}
+
+/**
+ * @brief Count the frames of one dropped buffer
+ */
+static inline void account(struct null_state *state, uint32_t frames)
+{
+	state->frame_count += frames;
+	state->buffer_count++;
+
+	/* Progress for debugging, formatted on the main loop (null-rtlog.c) */
+	if (spa_unlikely(state->buffer_count % 1000 == 0) &&
+	    spa_log_level_enabled(state->log, SPA_LOG_LEVEL_TRACE)) {
+		null_rtlog_push(state, NULL_RTLOG_PROGRESS, 0,
+				state->frame_count, state->buffer_count);
+	}
+}
+
+/*
+ * GENERATED KERNELS:
+ * =================
+ * The frame stride is a compile-time constant in each variant, so the
+ * division becomes a multiply or a shift.
+ */
+#define DEFINE_INTERLEAVED(size, channels)					\
+static int process_s##size##c##channels(struct null_state *state)		\
+{										\
+	struct spa_io_buffers *io = state->rt.io;					\
+	struct spa_buffer *buf;							\
+										\
+	if ((buf = dequeue(state, io)) == NULL)					\
+		return SPA_STATUS_NEED_DATA;					\
+	if (spa_likely(buf->datas[0].chunk != NULL))				\
+		account(state, buf->datas[0].chunk->size / ((size) * (channels))); \
+	return consume(io);							\
+}
+
+#define DEFINE_PLANAR(size)							\
+static int process_s##size##_planar(struct null_state *state)			\
+{										\
+	struct spa_io_buffers *io = state->rt.io;					\
+	struct spa_buffer *buf;							\
+										\
+	if ((buf = dequeue(state, io)) == NULL)					\
+		return SPA_STATUS_NEED_DATA;					\
+	if (spa_likely(buf->datas[0].chunk != NULL))				\
+		account(state, buf->datas[0].chunk->size / (size));		\
+	return consume(io);							\
+}
+
+NULL_AUDIO_KERNELS(DEFINE_INTERLEAVED, DEFINE_PLANAR)
+
+/*
+ * FIXED KERNELS:
+ * =============
+ */
+
+/** Node not running: leave the io area alone */
+static int process_idle(struct null_state *state)
+{
+	return SPA_STATUS_OK;
+}
+
+/** Grouped sink: consumed by the shared aggregator */
+static int process_group(struct null_state *state)
+{
+	return null_group_process(state);
+}
+
+/** Statistics disabled: hand buffers back without looking at them */
+static int process_consume(struct null_state *state)
+{
+	struct spa_io_buffers *io = state->rt.io;
+
+	if (dequeue(state, io) == NULL)
+		return SPA_STATUS_NEED_DATA;
+	return consume(io);
+}
+
+/**
+ * @brief Video sink: count frames, bytes and frame interval jitter
+ *
+ * Only the chunk sizes and the buffer header are read, the frame memory
+ * itself is never touched so DMA-BUFs don't need to be mapped.
+ */
+static int process_video(struct null_state *state)
+{
+	struct spa_io_buffers *io = state->rt.io;
+	struct spa_meta_header *h;
+	struct spa_buffer *buf;
+	uint64_t bytes = 0, time, interval, ref, jitter;
+	uint32_t i;
+
+	if ((buf = dequeue(state, io)) == NULL)
+		return SPA_STATUS_NEED_DATA;
+
+	for (i = 0; i < buf->n_datas; i++) {
+		if (buf->datas[i].chunk != NULL)
+			bytes += buf->datas[i].chunk->size;
+	}
+
+	/* Producer timestamps when available, arrival time otherwise */
+	h = spa_buffer_find_meta_data(buf, SPA_META_Header, sizeof(*h));
+	time = (h != NULL && h->pts > 0) ? (uint64_t) h->pts : null_get_time(state);
+
+	if (state->last_frame_time != 0 && time > state->last_frame_time) {
+		interval = time - state->last_frame_time;
+
+		/*
+		 * Jitter is the deviation from the nominal interval, or from
+		 * the previous interval for variable framerates.
+		 */
+		ref = state->rt.frame_interval ? state->rt.frame_interval : state->last_interval;
+		if (ref != 0) {
+			jitter = interval > ref ? interval - ref : ref - interval;
+			state->jitter_sum += jitter;
+			state->jitter_max = SPA_MAX(state->jitter_max, jitter);
+			state->jitter_count++;
+		}
+		state->last_interval = interval;
+	}
+	state->last_frame_time = time;
+	state->byte_count += bytes;
+
+	account(state, 1);
+
+	return consume(io);
+}
+
+/**
+ * @brief Control sink: walk the event sequence in place
+ *
+ * Events are counted by type and their offsets are checked against the
+ * current quantum; nothing is copied.
+ */
+static int process_control(struct null_state *state)
+{
+	struct spa_io_buffers *io = state->rt.io;
+	struct spa_io_position *position = state->rt.position;
+	struct spa_pod_sequence *seq;
+	struct spa_pod_control *c;
+	struct spa_buffer *buf;
+	struct spa_data *d;
+	void *data;
+	uint32_t quantum, last = 0, n_events = 0;
+
+	if ((buf = dequeue(state, io)) == NULL)
+		return SPA_STATUS_NEED_DATA;
+
+	d = &buf->datas[0];
+	data = state->rt.data[io->buffer_id];
+	if (spa_unlikely(data == NULL || d->chunk == NULL))
+		goto done;
+
+	seq = spa_pod_from_data(data, d->maxsize, d->chunk->offset, d->chunk->size);
+	if (spa_unlikely(seq == NULL || !spa_pod_is_sequence(&seq->pod))) {
+		state->bad_sequences++;
+		goto done;
+	}
+
+	quantum = position ? position->clock.duration : UINT32_MAX;
+
+	SPA_POD_SEQUENCE_FOREACH(seq, c) {
+		state->control_events[SPA_MIN(c->type, NULL_CONTROL_TYPES - 1u)]++;
+
+		if (c->type == SPA_CONTROL_Midi && SPA_POD_BODY_SIZE(&c->value) > 0) {
+			uint8_t status = *(uint8_t *) SPA_POD_BODY(&c->value);
+
+			if (status & 0x80)
+				state->midi_events[(status >> 4) & 0x7]++;
+		}
+
+		if (c->offset < last)
+			state->unordered_events++;
+		if (c->offset >= quantum)
+			state->late_events++;
+
+		state->offset_sum += c->offset;
+		state->offset_min = SPA_MIN(state->offset_min, c->offset);
+		state->offset_max = SPA_MAX(state->offset_max, c->offset);
+		last = c->offset;
+		n_events++;
+	}
+done:
+	account(state, n_events);
+
+	return consume(io);
+}
+
+/**
+ * @brief Encoded audio: count compressed frames without decoding
+ *
+ * The frame headers are parsed in place by null_encoded_parse() from the
+ * memory mapped in use_buffers, buffers without it are only counted by
+ * size.
+ */
+static int process_encoded(struct null_state *state)
+{
+	struct spa_io_buffers *io = state->rt.io;
+	struct spa_buffer *buf;
+	struct spa_data *d;
+	void *data;
+	uint32_t offset, size, frames = 0;
+
+	if ((buf = dequeue(state, io)) == NULL)
+		return SPA_STATUS_NEED_DATA;
+
+	d = &buf->datas[0];
+	if (spa_unlikely(d->chunk == NULL))
+		goto done;
+
+	offset = SPA_MIN(d->chunk->offset, d->maxsize);
+	size = SPA_MIN(d->chunk->size, d->maxsize - offset);
+
+	data = state->rt.data[io->buffer_id];
+	if (spa_likely(data != NULL))
+		frames = null_encoded_parse(state, SPA_PTROFF(data, offset, uint8_t), size);
+	state->byte_count += size;
+done:
+	account(state, frames);
+
+	return consume(io);
+}
+
+/** Any other layout: stride computed at set_param time */
+static int process_generic(struct null_state *state)
+{
+	struct spa_io_buffers *io = state->rt.io;
+	struct spa_buffer *buf;
+
+	if ((buf = dequeue(state, io)) == NULL)
+		return SPA_STATUS_NEED_DATA;
+	if (spa_likely(buf->datas[0].chunk != NULL))
+		account(state, buf->datas[0].chunk->size / state->rt.frame_stride);
+	return consume(io);
+}
+
+/*
+ * KERNEL LOOKUP TABLE:
+ * ===================
+ * Generated from the same X-macro table as the kernels.
+ */
+struct kernel_info {
+	uint32_t size;
+	uint32_t channels;      /**< 0 for planar kernels */
+	null_process_func_t process;
+};
+
+#define INTERLEAVED_INFO(size, channels) \
+	{ (size), (channels), process_s##size##c##channels },
+#define PLANAR_INFO(size) \
+	{ (size), 0, process_s##size##_planar },
+
+static const struct kernel_info kernels[] = {
+	NULL_AUDIO_KERNELS(INTERLEAVED_INFO, PLANAR_INFO)
+};
+
+uint32_t null_audio_sample_size(uint32_t format)
+{
+	switch (format) {
+	case SPA_AUDIO_FORMAT_S8:
+	case SPA_AUDIO_FORMAT_U8:
+	case SPA_AUDIO_FORMAT_ULAW:
+	case SPA_AUDIO_FORMAT_ALAW:
+	case SPA_AUDIO_FORMAT_S8P:
+	case SPA_AUDIO_FORMAT_U8P:
+		return 1;
+	case SPA_AUDIO_FORMAT_S16_LE:
+	case SPA_AUDIO_FORMAT_S16_BE:
+	case SPA_AUDIO_FORMAT_U16_LE:
+	case SPA_AUDIO_FORMAT_U16_BE:
+	case SPA_AUDIO_FORMAT_S16P:
+		return 2;
+	case SPA_AUDIO_FORMAT_S24_LE:
+	case SPA_AUDIO_FORMAT_S24_BE:
+	case SPA_AUDIO_FORMAT_U24_LE:
+	case SPA_AUDIO_FORMAT_U24_BE:
+	case SPA_AUDIO_FORMAT_S20_LE:
+	case SPA_AUDIO_FORMAT_S20_BE:
+	case SPA_AUDIO_FORMAT_U20_LE:
+	case SPA_AUDIO_FORMAT_U20_BE:
+	case SPA_AUDIO_FORMAT_S18_LE:
+	case SPA_AUDIO_FORMAT_S18_BE:
+	case SPA_AUDIO_FORMAT_U18_LE:
+	case SPA_AUDIO_FORMAT_U18_BE:
+	case SPA_AUDIO_FORMAT_S24P:
+		return 3;
+	case SPA_AUDIO_FORMAT_S24_32_LE:
+	case SPA_AUDIO_FORMAT_S24_32_BE:
+	case SPA_AUDIO_FORMAT_U24_32_LE:
+	case SPA_AUDIO_FORMAT_U24_32_BE:
+	case SPA_AUDIO_FORMAT_S32_LE:
+	case SPA_AUDIO_FORMAT_S32_BE:
+	case SPA_AUDIO_FORMAT_U32_LE:
+	case SPA_AUDIO_FORMAT_U32_BE:
+	case SPA_AUDIO_FORMAT_F32_LE:
+	case SPA_AUDIO_FORMAT_F32_BE:
+	case SPA_AUDIO_FORMAT_S24_32P:
+	case SPA_AUDIO_FORMAT_S32P:
+	case SPA_AUDIO_FORMAT_F32P:
+		return 4;
+	case SPA_AUDIO_FORMAT_F64_LE:
+	case SPA_AUDIO_FORMAT_F64_BE:
+	case SPA_AUDIO_FORMAT_F64P:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+uint32_t null_audio_frame_stride(const struct spa_audio_info_raw *raw)
+{
+	uint32_t size = null_audio_sample_size(raw->format);
+
+	return SPA_AUDIO_FORMAT_IS_PLANAR(raw->format) ? size : size * raw->channels;
+}
+
+int null_audio_check_raw(struct spa_log *log, const char *name, const void *obj,
+                         const struct spa_audio_info_raw *raw)
+{
+	if (raw->channels == 0 || raw->channels > NULL_AUDIO_MAX_CHANNELS) {
+		spa_log_error(log, "%s %p: invalid channel count %d", name, obj, raw->channels);
+		return -EINVAL;
+	}
+
+	if (raw->rate == 0 || raw->rate > NULL_AUDIO_MAX_RATE) {
+		spa_log_error(log, "%s %p: invalid sample rate %d", name, obj, raw->rate);
+		return -EINVAL;
+	}
+
+	if (null_audio_sample_size(raw->format) == 0) {
+		spa_log_error(log, "%s %p: unsupported sample format %d", name, obj, raw->format);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int do_apply_config(struct spa_loop *loop, bool async, uint32_t seq,
+                           const void *data, size_t size, void *user_data)
+{
+	struct null_state *state = user_data;
+	const struct null_config *config = data;
+
+	/* Counters that only make sense within one format start over */
+	if (config->format_serial != state->rt.format_serial) {
+		state->encoded_samples = 0;
+		state->encoded_payload = 0;
+		state->encoded_skip = 0;
+		state->last_frame_time = 0;
+		state->last_interval = 0;
+	}
+	/* The auto latency window restarts whenever auto mode is toggled */
+	if (config->latency_auto != state->rt.latency_auto) {
+		state->auto_cycles = 0;
+		state->auto_peak = 0;
+	}
+	state->rt = *config;
+	null_group_apply(state);
+
+	return 0;
+}
+
+static void apply_config(struct null_state *state, const struct null_config *config)
+{
+	/* Without a data loop nothing can be processing concurrently */
+	if (state->data_loop != NULL)
+		spa_loop_invoke(state->data_loop, do_apply_config, 0,
+				config, sizeof(*config), true, state);
+	else
+		do_apply_config(NULL, false, 0, config, sizeof(*config), state);
+}
+
+/** Copy the io areas and the buffer table from the control plane */
+static void config_buffers(struct null_state *state, struct null_config *config)
+{
+	uint32_t i;
+
+	config->io = state->io;
+	config->position = state->position;
+	config->clock = state->clock;
+	config->n_buffers = state->n_buffers;
+	for (i = 0; i < state->n_buffers; i++) {
+		config->buffers[i] = state->buffers[i];
+		config->data[i] = state->mems[i].data;
+	}
+}
+
+void null_process_set_buffers(struct null_state *state)
+{
+	/*
+	 * rt is only ever written by a blocking invoke from this thread, so
+	 * reading it here sees the applied config.
+	 */
+	struct null_config config = state->rt;
+
+	spa_zero(config.buffers);
+	spa_zero(config.data);
+	config_buffers(state, &config);
+
+	/*
+	 * A new io area waits for the next null_process_select() like any
+	 * other batched change, a removed one must be gone right away.
+	 */
+	if (state->io != NULL)
+		config.io = state->rt.io;
+	if (state->position != NULL)
+		config.position = state->rt.position;
+	if (state->clock != NULL)
+		config.clock = state->rt.clock;
+
+	apply_config(state, &config);
+}
+
+void null_process_select(struct null_state *state)
+{
+	const struct spa_audio_info_raw *raw = &state->current_format.info.raw;
+	struct null_config config = {
+		.frame_interval = state->frame_interval,
+		.frame_stride = state->frame_stride,
+		.media_subtype = state->current_format.media_subtype,
+		.encoded_channels = state->encoded_channels,
+		.encoded_codec = state->encoded_codec,
+		.format_serial = state->format_serial,
+		.latency = state->process_latency,
+		.latency_auto = state->latency_auto,
+	};
+	null_process_func_t process = process_generic;
+	const char *name = "generic";
+	uint32_t i, size, channels;
+
+	if (!state->started || !state->have_format) {
+		process = process_idle;
+		name = "idle";
+	} else if (!state->stats) {
+		process = process_consume;
+		name = "consume";
+	} else if (state->kind == NULL_SINK_VIDEO) {
+		process = process_video;
+		name = "video";
+	} else if (state->kind == NULL_SINK_CONTROL) {
+		process = process_control;
+		name = "control";
+	} else if (state->current_format.media_subtype != SPA_MEDIA_SUBTYPE_raw) {
+		process = process_encoded;
+		name = "encoded";
+	} else if (state->group != NULL) {
+		/* The aggregator only counts audio frames by stride */
+		process = process_group;
+		name = "group";
+		config.grouped = true;
+	} else {
+		size = null_audio_sample_size(raw->format);
+		channels = SPA_AUDIO_FORMAT_IS_PLANAR(raw->format) ? 0 : raw->channels;
+
+		for (i = 0; i < SPA_N_ELEMENTS(kernels); i++) {
+			if (kernels[i].size == size && kernels[i].channels == channels) {
+				process = kernels[i].process;
+				name = "specialized";
+				break;
+			}
+		}
+	}
+
+	/* The device delay follows the quantum of every cycle */
+	if (null_latency_active(&state->process_latency) && process != process_idle &&
+	    state->clock != NULL && state->position != NULL) {
+		config.latency_kernel = process;
+		process = null_latency_process;
+	}
+
+	/* Graph timing samples the clock in front of the kernel */
+	if (state->timing_enabled && process != process_idle &&
+	    (state->clock != NULL || state->position != NULL)) {
+		config.timing_kernel = process;
+		process = null_timing_process;
+	}
+
+	/* Monitors see the counters after every cycle */
+	if (state->shm != NULL && process != process_idle) {
+		config.shm_kernel = process;
+		process = null_shm_process;
+	}
+
+	/* Hardware counters measure whichever kernel was selected */
+	if (state->perf.open && process != process_idle) {
+		config.perf_kernel = process;
+		process = null_perf_process;
+	}
+
+	if (state->rt.process != process)
+		spa_log_debug(state->log, "null-sink %p: using %s process kernel (%u bytes/frame)",
+			      state, name, state->frame_stride);
+
+	config.process = process;
+	config_buffers(state, &config);
+
+	apply_config(state, &config);
+}
@@ -0,0 +1,245 @@
+/* SPA Null Sink Runtime Props */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-props.c
+ * @brief SPA Null Sink - Requested latency at runtime and auto quantum
+ *
+ * The quantum of a PipeWire graph follows the smallest node.latency of
+ * its nodes. The null sink publishes its requested latency as the
+ * node.latency item of its node info props, so changing it through
+ * Props moves the graph to another quantum.
+ *
+ * PROPS:
+ * =====
+ * Both are entries of SPA_PROP_params, the generic key/value struct:
+ *
+ *   null.latency        string "quantum/rate", e.g. "256/48000"
+ *   null.latency-auto   bool, let the sink tune its own latency
+ *
+ * AUTO MODE:
+ * =========
+ * While enabled and a graph clock is available, the timing wrapper
+ * (null-timing.c) feeds every cycle's load, the scheduling latency as a
+ * fraction of the cycle period, into a window of NULL_AUTO_WINDOW cycles.
+ * At the end of each window:
+ *
+ *   peak load >= NULL_AUTO_GROW_PERMILLE    double the quantum (near xrun)
+ *   peak load <  NULL_AUTO_SHRINK_PERMILLE  halve the quantum (headroom)
+ *
+ * within [NULL_AUTO_MIN_QUANTUM, clock.quantum-limit or
+ * NULL_AUTO_MAX_QUANTUM]. The decision is made in the data loop and
+ * applied on the main loop through a non-blocking spa_loop_invoke(),
+ * which updates the props and emits the node info.
+ *
+ * The window counters belong to the data loop. Toggling the prop only
+ * changes the control copy of latency_auto; the data loop sees it as
+ * rt.latency_auto after the next config swap, which also restarts the
+ * window.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+
+#include <spa/pod/builder.h>
+#include <spa/pod/parser.h>
+#include <spa/param/props.h>
+#include <spa/utils/atomic.h>
+#include <spa/utils/string.h>
+
+#include "null.h"
+
+#define NULL_AUTO_WINDOW		512
+#define NULL_AUTO_GROW_PERMILLE		800
+#define NULL_AUTO_SHRINK_PERMILLE	250
+#define NULL_AUTO_MIN_QUANTUM		32
+#define NULL_AUTO_MAX_QUANTUM		8192
+
+void null_props_update_info(struct null_state *state)
+{
+	uint32_t n_items = 0;
+
+	if (state->latency.num != 0 && state->latency.denom != 0) {
+		spa_scnprintf(state->latency_str, sizeof(state->latency_str), "%u/%u",
+			      state->latency.num, state->latency.denom);
+		state->info_items[n_items++] = SPA_DICT_ITEM_INIT(NULL_KEY_NODE_LATENCY,
+								  state->latency_str);
+	}
+	state->info_dict = SPA_DICT_INIT(state->info_items, n_items);
+	state->info.props = &state->info_dict;
+	state->info.change_mask |= SPA_NODE_CHANGE_MASK_PROPS;
+}
+
+static void set_latency(struct null_state *state, uint32_t num, uint32_t denom)
+{
+	if (state->latency.num == num && state->latency.denom == denom)
+		return;
+
+	state->latency = SPA_FRACTION(num, denom);
+	null_props_update_info(state);
+
+	state->params[NULL_NODE_PARAM_Props].user++;
+	state->info.change_mask |= SPA_NODE_CHANGE_MASK_PARAMS;
+
+	spa_log_info(state->log, "null-sink %p: requesting latency %u/%u%s",
+		     state, num, denom, state->latency_auto ? " (auto)" : "");
+
+	null_emit_node_info(state, false);
+}
+
+int null_props_enum(struct null_state *state, uint32_t id, uint32_t index,
+                    struct spa_pod_builder *b, struct spa_pod **param)
+{
+	struct spa_pod_frame f[2];
+	char latency[32] = "";
+
+	switch (id) {
+	case SPA_PARAM_PropInfo:
+		switch (index) {
+		case 0:
+			*param = spa_pod_builder_add_object(b,
+				SPA_TYPE_OBJECT_PropInfo, id,
+				SPA_PROP_INFO_name, SPA_POD_String(NULL_KEY_LATENCY),
+				SPA_PROP_INFO_description, SPA_POD_String("Requested latency (quantum/rate)"),
+				SPA_PROP_INFO_type, SPA_POD_String(latency),
+				SPA_PROP_INFO_params, SPA_POD_Bool(true));
+			return 1;
+		case 1:
+			*param = spa_pod_builder_add_object(b,
+				SPA_TYPE_OBJECT_PropInfo, id,
+				SPA_PROP_INFO_name, SPA_POD_String(NULL_KEY_LATENCY_AUTO),
+				SPA_PROP_INFO_description, SPA_POD_String("Tune latency to the measured load"),
+				SPA_PROP_INFO_type, SPA_POD_CHOICE_Bool(state->latency_auto),
+				SPA_PROP_INFO_params, SPA_POD_Bool(true));
+			return 1;
+		default:
+			return 0;
+		}
+
+	case SPA_PARAM_Props:
+		if (index > 0)
+			return 0;
+
+		if (state->latency.num != 0 && state->latency.denom != 0)
+			spa_scnprintf(latency, sizeof(latency), "%u/%u",
+				      state->latency.num, state->latency.denom);
+
+		spa_pod_builder_push_object(b, &f[0], SPA_TYPE_OBJECT_Props, id);
+		spa_pod_builder_prop(b, SPA_PROP_params, 0);
+		spa_pod_builder_push_struct(b, &f[1]);
+		spa_pod_builder_string(b, NULL_KEY_LATENCY);
+		spa_pod_builder_string(b, latency);
+		spa_pod_builder_string(b, NULL_KEY_LATENCY_AUTO);
+		spa_pod_builder_bool(b, state->latency_auto);
+		spa_pod_builder_pop(b, &f[1]);
+		*param = spa_pod_builder_pop(b, &f[0]);
+		return 1;
+
+	default:
+		return 0;
+	}
+}
+
+int null_props_set(struct null_state *state, const struct spa_pod *param)
+{
+	struct spa_pod *params = NULL;
+	struct spa_pod_parser prs;
+	struct spa_pod_frame f;
+	uint32_t num, denom;
+	int res;
+
+	if (param == NULL)
+		return 0;
+
+	if ((res = spa_pod_parse_object(param,
+			SPA_TYPE_OBJECT_Props, NULL,
+			SPA_PROP_params, SPA_POD_OPT_Pod(&params))) < 0)
+		return res;
+	if (params == NULL)
+		return 0;
+
+	spa_pod_parser_pod(&prs, params);
+	if (spa_pod_parser_push_struct(&prs, &f) < 0)
+		return -EINVAL;
+
+	while (true) {
+		const char *name;
+		struct spa_pod *pod;
+		char value[64];
+		bool b;
+
+		if (spa_pod_parser_get_string(&prs, &name) < 0 ||
+		    spa_pod_parser_get_pod(&prs, &pod) < 0)
+			break;
+
+		if (spa_streq(name, NULL_KEY_LATENCY) && spa_pod_is_string(pod)) {
+			if (spa_pod_copy_string(pod, sizeof(value), value) < 0)
+				continue;
+			if (value[0] == '\0') {
+				set_latency(state, 0, 0);
+			} else if (sscanf(value, "%u/%u", &num, &denom) == 2 && num && denom) {
+				set_latency(state, num, denom);
+			} else {
+				spa_log_warn(state->log, "null-sink %p: invalid %s '%s'",
+					     state, name, value);
+			}
+		} else if (spa_streq(name, NULL_KEY_LATENCY_AUTO) &&
+			   spa_pod_get_bool(pod, &b) >= 0) {
+			state->latency_auto = b;
+			state->params[NULL_NODE_PARAM_Props].user++;
+			state->info.change_mask |= SPA_NODE_CHANGE_MASK_PARAMS;
+			null_emit_node_info(state, false);
+		}
+	}
+	return 0;
+}
+
+static int do_auto_latency(struct spa_loop *loop, bool async, uint32_t seq,
+                           const void *data, size_t size, void *user_data)
+{
+	struct null_state *state = user_data;
+	const struct spa_fraction *latency = data;
+
+	SPA_ATOMIC_STORE(state->auto_pending, 0);
+	if (state->latency_auto)
+		set_latency(state, latency->num, latency->denom);
+	return 0;
+}
+
+void null_props_auto_sample(struct null_state *state, const struct spa_io_clock *clock,
+                            uint64_t latency_ns, uint64_t period_ns)
+{
+	struct spa_fraction next;
+	uint32_t load, quantum, max_quantum;
+
+	if (period_ns == 0)
+		return;
+
+	load = (uint32_t) SPA_MIN(latency_ns * 1000 / period_ns, (uint64_t) UINT32_MAX);
+	state->auto_peak = SPA_MAX(state->auto_peak, load);
+
+	if (++state->auto_cycles < NULL_AUTO_WINDOW)
+		return;
+
+	quantum = (uint32_t) clock->duration;
+	max_quantum = state->quantum_limit ? (uint32_t) state->quantum_limit : NULL_AUTO_MAX_QUANTUM;
+
+	if (state->auto_peak >= NULL_AUTO_GROW_PERMILLE)
+		quantum = SPA_MIN(quantum * 2, max_quantum);
+	else if (state->auto_peak < NULL_AUTO_SHRINK_PERMILLE)
+		quantum = SPA_MAX(quantum / 2, (uint32_t) NULL_AUTO_MIN_QUANTUM);
+
+	state->auto_cycles = 0;
+	state->auto_peak = 0;
+
+	if (quantum == clock->duration || state->main_loop == NULL)
+		return;
+
+	/* Queue a single change, the main loop clears the flag when it ran */
+	if (!SPA_ATOMIC_CAS(state->auto_pending, 0, 1))
+		return;
+
+	next = SPA_FRACTION(quantum, clock->rate.denom / SPA_MAX(clock->rate.num, 1u));
+	spa_loop_invoke(state->main_loop, do_auto_latency, 0, &next, sizeof(next), false, state);
+}
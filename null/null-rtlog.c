@@ -0,0 +1,136 @@
+/* SPA Null Sink RT-safe Diagnostics Ring */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-rtlog.c
+ * @brief SPA Null Sink - Lock-free diagnostics from the data loop
+ *
+ * spa_log_*() formats its message and may write to a file, a pipe or the
+ * journal, any of which can block. The process kernels therefore never
+ * log directly: they push a fixed-size record (event code, timestamp,
+ * raw arguments) into a single-producer single-consumer ring, and the
+ * records are formatted later on the main loop.
+ *
+ * RT LOG RING:
+ * ===========
+ *
+ *   data loop                              main loop
+ *   ---------                              ---------
+ *   null_rtlog_push()                      do_drain()
+ *     write record at write index            read records, spa_log_*()
+ *     spa_ringbuffer_write_update()          spa_ringbuffer_read_update()
+ *     first record: spa_loop_invoke() ---->  clear pending flag
+ *
+ * - The ring holds NULL_RTLOG_SIZE records inside null_state, so it is
+ *   covered by null.mlock and never allocates.
+ * - A full ring drops the new record and only counts it; the drain
+ *   reports the number of dropped records. A flood of bad buffer ids
+ *   therefore costs one compare and an increment per cycle.
+ * - Only one drain is queued on the main loop at a time, so a flood
+ *   causes at most one non-blocking invoke per drain.
+ *
+ * Without a main loop in the support interfaces the ring is drained on
+ * Pause/Suspend and when the handle is cleared.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+
+#include <spa/utils/atomic.h>
+#include <spa/utils/ringbuffer.h>
+
+#include "null.h"
+
+static int do_drain(struct spa_loop *loop, bool async, uint32_t seq,
+                    const void *data, size_t size, void *user_data)
+{
+	struct null_state *state = user_data;
+
+	null_rtlog_drain(state);
+	return 0;
+}
+
+void null_rtlog_push(struct null_state *state, uint32_t event,
+                     uint32_t arg0, uint64_t arg1, uint64_t arg2)
+{
+	struct null_rtlog *r = &state->rtlog;
+	struct null_rtlog_record *rec;
+	uint32_t index;
+	int32_t filled;
+
+	filled = spa_ringbuffer_get_write_index(&r->ring, &index);
+	if (filled < 0 || filled >= NULL_RTLOG_SIZE) {
+		r->dropped++;
+		return;
+	}
+
+	rec = &r->records[index & (NULL_RTLOG_SIZE - 1)];
+	rec->time = state->rt.position ? state->rt.position->clock.nsec : null_get_time(state);
+	rec->event = event;
+	rec->arg0 = arg0;
+	rec->arg1 = arg1;
+	rec->arg2 = arg2;
+	spa_ringbuffer_write_update(&r->ring, index + 1);
+
+	/* Queue a single drain, further records ride along with it */
+	if (state->main_loop != NULL && SPA_ATOMIC_CAS(r->pending, 0, 1))
+		spa_loop_invoke(state->main_loop, do_drain, 0, NULL, 0, false, state);
+}
+
+void null_rtlog_drain(struct null_state *state)
+{
+	struct null_rtlog *r = &state->rtlog;
+	struct null_rtlog_record rec;
+	uint32_t index, dropped;
+
+	SPA_ATOMIC_STORE(r->pending, 0);
+
+	while (spa_ringbuffer_get_read_index(&r->ring, &index) > 0) {
+		rec = r->records[index & (NULL_RTLOG_SIZE - 1)];
+		spa_ringbuffer_read_update(&r->ring, index + 1);
+
+		switch (rec.event) {
+		case NULL_RTLOG_INVALID_BUFFER_ID:
+			spa_log_warn(state->log, "null-sink %p: invalid buffer id %u "
+				     "(%" PRIu64 " buffers) at %" PRIu64,
+				     state, rec.arg0, rec.arg1, rec.time);
+			break;
+		case NULL_RTLOG_NULL_BUFFER:
+			spa_log_warn(state->log, "null-sink %p: null buffer %u at %" PRIu64,
+				     state, rec.arg0, rec.time);
+			break;
+		case NULL_RTLOG_PROGRESS:
+			spa_log_trace(state->log, "null-sink %p: dropped %" PRIu64
+				      " frames in %" PRIu64 " buffers at %" PRIu64,
+				      state, rec.arg1, rec.arg2, rec.time);
+			break;
+		default:
+			spa_log_warn(state->log, "null-sink %p: unknown RT event %u",
+				     state, rec.event);
+			break;
+		}
+	}
+
+	dropped = SPA_ATOMIC_LOAD(r->dropped);
+	if (dropped != r->reported) {
+		spa_log_warn(state->log, "null-sink %p: %u RT log records dropped",
+			     state, dropped - r->reported);
+		r->reported = dropped;
+	}
+}
+
+static int do_flush(struct spa_loop *loop, bool async, uint32_t seq,
+                    const void *data, size_t size, void *user_data)
+{
+	return 0;
+}
+
+void null_rtlog_flush(struct null_state *state)
+{
+	/* Run any drain still queued on the main loop before the state goes away */
+	if (state->main_loop != NULL)
+		spa_loop_invoke(state->main_loop, do_flush, 0, NULL, 0, true, state);
+
+	null_rtlog_drain(state);
+}
@@ -0,0 +1,215 @@
+/* SPA Null Sink Shared-Memory Stats */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-shm.c
+ * @brief SPA Null Sink - Publish counters in a POSIX shm segment
+ *
+ * Writer side of the layout in null-shm.h. The segment is created at
+ * impl_init when null.shm is set, updated by null_shm_process() after
+ * every kernel run, and unlinked when the handle is cleared.
+ *
+ * The data loop is the only writer: the final update on Pause is made
+ * through a blocking spa_loop_invoke() on the data loop, so the sequence
+ * lock never sees two writers.
+ *
+ * STALE SEGMENTS:
+ * ==============
+ * A sink that was killed never unlinks its segment, and the next sink
+ * with the same node name would find the name taken. When the existing
+ * segment carries our magic and the pid in its header is gone, it is
+ * unlinked and created again. Segments of live processes are left
+ * alone.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <spa/utils/string.h>
+
+#include "null.h"
+#include "null-shm.h"
+
+static void make_name(char *dst, size_t size, const char *name)
+{
+	size_t i, len;
+
+	len = spa_scnprintf(dst, size, "%s%s", NULL_SHM_PREFIX, name);
+	for (i = strlen(NULL_SHM_PREFIX); i < len; i++) {
+		char c = dst[i];
+
+		if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+		      (c >= '0' && c <= '9') || c == '.' || c == '_' || c == '-'))
+			dst[i] = '_';
+	}
+}
+
+/** True when @p path is a null sink segment whose owner has exited */
+static bool segment_is_stale(const char *path)
+{
+	struct null_shm_header *h;
+	struct stat st;
+	bool stale = false;
+	int fd;
+
+	fd = shm_open(path, O_RDONLY | O_CLOEXEC, 0);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(*h)) {
+		h = mmap(NULL, sizeof(*h), PROT_READ, MAP_SHARED, fd, 0);
+		if (h != MAP_FAILED) {
+			stale = __atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) == NULL_SHM_MAGIC &&
+				h->pid != 0 && (pid_t) h->pid != getpid() &&
+				kill((pid_t) h->pid, 0) < 0 && errno == ESRCH;
+			munmap(h, sizeof(*h));
+		}
+	}
+	close(fd);
+
+	return stale;
+}
+
+int null_shm_open(struct null_state *state, const char *name)
+{
+	struct null_shm_segment *seg;
+	char path[sizeof(seg->header.name)];
+	char fallback[64];
+	int fd, res;
+
+	if (name == NULL) {
+		spa_scnprintf(fallback, sizeof(fallback), "null-sink-%d-%p", getpid(), state);
+		name = fallback;
+	}
+	make_name(path, sizeof(path), name);
+
+	fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0 && errno == EEXIST && segment_is_stale(path)) {
+		spa_log_info(state->log, "null-sink %p: replacing stale stats segment %s",
+			     state, path);
+		shm_unlink(path);
+		fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	}
+	if (fd < 0) {
+		res = -errno;
+		spa_log_warn(state->log, "null-sink %p: can't create stats segment %s: %m",
+			     state, path);
+		return res;
+	}
+
+	if (ftruncate(fd, sizeof(*seg)) < 0) {
+		res = -errno;
+		goto error;
+	}
+
+	seg = mmap(NULL, sizeof(*seg), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (seg == MAP_FAILED) {
+		res = -errno;
+		goto error;
+	}
+	close(fd);
+
+	seg->header.version = NULL_SHM_VERSION;
+	seg->header.size = sizeof(*seg);
+	seg->header.pid = getpid();
+	seg->header.kind = state->kind;
+	memcpy(seg->header.name, path, sizeof(path));
+
+	/* Magic last: a reader that sees it sees the complete header */
+	__atomic_store_n(&seg->header.magic, NULL_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	state->shm = seg;
+
+	spa_log_info(state->log, "null-sink %p: publishing stats in %s", state, path);
+
+	return 0;
+
+error:
+	spa_log_warn(state->log, "null-sink %p: can't set up stats segment %s: %s",
+		     state, path, spa_strerror(res));
+	close(fd);
+	shm_unlink(path);
+	return res;
+}
+
+void null_shm_close(struct null_state *state)
+{
+	struct null_shm_segment *seg = state->shm;
+
+	if (seg == NULL)
+		return;
+
+	shm_unlink(seg->header.name);
+	munmap(seg, sizeof(*seg));
+	state->shm = NULL;
+}
+
+static inline void publish(struct null_state *state, bool started)
+{
+	struct null_shm_counters *c = &state->shm->counters;
+	uint32_t seq = c->seq;
+	uint64_t frames = state->frame_count, buffers = state->buffer_count;
+	uint64_t time = state->timing.now;
+
+	/* Reuse the time null_timing_process() took this cycle, if any */
+	if (time == 0)
+		time = null_get_time(state);
+	state->timing.now = 0;
+
+	/* Grouped sinks are counted in the aggregator table */
+	if (state->group != NULL)
+		null_group_get_stats(state, &frames, &buffers);
+
+	__atomic_store_n(&c->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	c->started = started;
+	c->time = time;
+	c->frames = frames;
+	c->buffers = buffers;
+	c->empty = state->empty_count;
+	c->bytes = state->byte_count;
+	c->latency_count = state->timing.latency.count;
+	c->latency_sum = state->timing.latency.sum;
+	c->latency_max = state->timing.latency.max;
+	c->jitter_count = state->timing.jitter.count;
+	c->jitter_sum = state->timing.jitter.sum;
+	c->jitter_max = state->timing.jitter.max;
+	c->rtlog_dropped = state->rtlog.dropped;
+
+	__atomic_store_n(&c->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+int null_shm_process(struct null_state *state)
+{
+	int res = state->rt.shm_kernel(state);
+
+	publish(state, true);
+
+	return res;
+}
+
+static int do_publish_stopped(struct spa_loop *loop, bool async, uint32_t seq,
+                              const void *data, size_t size, void *user_data)
+{
+	publish(user_data, false);
+	return 0;
+}
+
+void null_shm_stopped(struct null_state *state)
+{
+	if (state->shm == NULL)
+		return;
+
+	if (state->data_loop != NULL)
+		spa_loop_invoke(state->data_loop, do_publish_stopped, 0, NULL, 0, true, state);
+	else
+		publish(state, false);
+}
@@ -0,0 +1,129 @@
+/* SPA Null Sink Shared-Memory Stats Layout */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-shm.h
+ * @brief SPA Null Sink - Stats segment layout for external monitors
+ *
+ * With the null.shm property every null sink publishes its counters into
+ * a POSIX shared memory segment named
+ *
+ *   /spa-null.<node.name>
+ *
+ * with characters other than [A-Za-z0-9._-] replaced by '_'. A monitor
+ * can shm_open() and mmap() thousands of them read-only and scrape them
+ * without a PipeWire protocol round-trip per node.
+ *
+ * This header is self-contained (no SPA or PipeWire includes) so it can
+ * be copied into monitoring tools as is.
+ *
+ * SEGMENT LAYOUT:
+ * ==============
+ * Version NULL_SHM_VERSION. Both parts start on their own cache line so
+ * the counter updates of the data loop never share a line with the
+ * constant header:
+ *
+ *   header    written once at creation: magic, version, size, pid, kind
+ *   counters  rewritten every cycle under a sequence lock
+ *
+ * New fields are only appended to the counters, readers check
+ * header.version and header.size before using them.
+ *
+ * SEQUENCE LOCK:
+ * =============
+ * The data loop is the only writer. It makes counters.seq odd, writes
+ * the counters, and makes it even again. A reader copies the counters
+ * and retries while seq was odd or changed meanwhile, which is what
+ * null_shm_read() implements. Readers never block the writer.
+ */
+
+#ifndef SPA_NULL_SHM_H
+#define SPA_NULL_SHM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+/** "NULL" in little endian */
+#define NULL_SHM_MAGIC		0x4c4c554eu
+
+/** Layout version, bumped on incompatible changes */
+#define NULL_SHM_VERSION	1
+
+/** Prefix of the segment names */
+#define NULL_SHM_PREFIX		"/spa-null."
+
+/** Cache line size the layout is padded to */
+#define NULL_SHM_CACHE_LINE	64
+
+/** Constant part, written once before the segment is used */
+struct null_shm_header {
+	uint32_t magic;               /**< NULL_SHM_MAGIC */
+	uint32_t version;             /**< NULL_SHM_VERSION */
+	uint32_t size;                /**< sizeof(struct null_shm_segment) */
+	uint32_t pid;                 /**< Process owning the sink */
+	uint32_t kind;                /**< 0 audio, 1 video, 2 control */
+	uint32_t reserved[3];
+	char name[96];                /**< Segment name, NUL terminated */
+} __attribute__((aligned(NULL_SHM_CACHE_LINE)));
+
+/** Counters, rewritten by the data loop every cycle */
+struct null_shm_counters {
+	uint32_t seq;                 /**< Sequence lock, odd while writing */
+	uint32_t started;             /**< 1 while the sink is processing */
+	uint64_t time;                /**< Monotonic time of the cycle or update (ns) */
+	uint64_t frames;              /**< Frames dropped */
+	uint64_t buffers;             /**< Buffers dropped */
+	uint64_t empty;               /**< Cycles without new data */
+	uint64_t bytes;               /**< Bytes dropped (video, encoded) */
+	uint64_t latency_count;       /**< Scheduling latency samples */
+	uint64_t latency_sum;         /**< Sum of scheduling latency (ns) */
+	uint64_t latency_max;         /**< Max scheduling latency (ns) */
+	uint64_t jitter_count;        /**< Cycle jitter samples */
+	uint64_t jitter_sum;          /**< Sum of cycle jitter (ns) */
+	uint64_t jitter_max;          /**< Max cycle jitter (ns) */
+	uint64_t rtlog_dropped;       /**< Diagnostic records lost */
+} __attribute__((aligned(NULL_SHM_CACHE_LINE)));
+
+/** The whole segment */
+struct null_shm_segment {
+	struct null_shm_header header;
+	struct null_shm_counters counters;
+};
+
+/**
+ * @brief Take a consistent snapshot of the counters
+ *
+ * @param seg  Mapped segment
+ * @param out  Output for the snapshot
+ * @param max_tries Give up after this many torn reads
+ *
+ * @return 0 on success, -1 when no consistent snapshot was obtained
+ */
+static inline int null_shm_read(const struct null_shm_segment *seg,
+                                struct null_shm_counters *out, int max_tries)
+{
+	uint32_t s1, s2;
+
+	while (max_tries-- > 0) {
+		s1 = __atomic_load_n(&seg->counters.seq, __ATOMIC_ACQUIRE);
+		if (s1 & 1)
+			continue;
+		memcpy(out, (const void *) &seg->counters, sizeof(*out));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		s2 = __atomic_load_n(&seg->counters.seq, __ATOMIC_RELAXED);
+		if (s1 == s2)
+			return 0;
+	}
+	return -1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPA_NULL_SHM_H */
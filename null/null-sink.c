@@ -48,18 +48,62 @@
 
 
 #include <errno.h>
+#include <inttypes.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include <spa/utils/result.h>
+#include <spa/utils/keys.h>
 #include <spa/utils/string.h>
 #include <spa/debug/format.h>
 #include <spa/debug/log.h>
+#include <spa/debug/types.h>
+#include <spa/buffer/type-info.h>
+#include <spa/param/buffers.h>
+#include <spa/param/latency-utils.h>
 #include <spa/pod/builder.h>
 #include <spa/pod/filter.h>
 #include <spa/param/audio/format-utils.h>
+#include <spa/param/audio/raw-types.h>
 
 #include "null.h"
+#include "null-probes.h"
+
+/*
+ * STATIC TRACEPOINTS:
+ * ==================
+ * One semaphore per probe, see null-probes.h. Entry and exit probes
+ * wrap the node methods below; the node_*() functions hold the actual
+ * implementations.
+ */
+NULL_PROBE_DEFINE(process_entry);
+NULL_PROBE_DEFINE(process_exit);
+NULL_PROBE_DEFINE(set_param_entry);
+NULL_PROBE_DEFINE(set_param_exit);
+NULL_PROBE_DEFINE(send_command_entry);
+NULL_PROBE_DEFINE(send_command_exit);
+NULL_PROBE_DEFINE(use_buffers_entry);
+NULL_PROBE_DEFINE(use_buffers_exit);
+NULL_PROBE_DEFINE(set_io_entry);
+NULL_PROBE_DEFINE(set_io_exit);
+
+/** Chunk size of the pending buffer, for the process_entry probe */
+static inline uint32_t null_probe_chunk_size(struct null_state *state)
+{
+	struct spa_io_buffers *io = state->rt.io;
+	struct spa_buffer *buf;
+
+	if (io == NULL || io->status != SPA_STATUS_HAVE_DATA ||
+	    io->buffer_id >= state->rt.n_buffers ||
+	    (buf = state->rt.buffers[io->buffer_id]) == NULL ||
+	    buf->n_datas == 0 || buf->datas[0].chunk == NULL)
+		return 0;
+
+	return buf->datas[0].chunk->size;
+}
 
 /*
  * SPA NODE INTERFACE IMPLEMENTATION:
@@ -68,6 +112,92 @@
  * It defines the contract between nodes and the PipeWire graph engine.
  */
 
+/**
+ * @brief Emit node info to all listeners
+ *
+ * Only the fields flagged in info.change_mask are sent, all of them when
+ * @p full is set. Params whose user counter was bumped flip their
+ * SPA_PARAM_INFO_SERIAL flag so listeners know to enumerate them again.
+ *
+ * @param state Null sink state
+ * @param full True to emit every field
+ */
+void null_emit_node_info(struct null_state *state, bool full)
+{
+	uint64_t old = full ? state->info.change_mask : 0;
+	uint32_t i;
+
+	if (full)
+		state->info.change_mask = state->info_all;
+	if (state->info.change_mask == 0)
+		return;
+
+	if (state->info.change_mask & SPA_NODE_CHANGE_MASK_PARAMS) {
+		for (i = 0; i < state->info.n_params; i++) {
+			if (state->params[i].user > 0) {
+				state->params[i].flags ^= SPA_PARAM_INFO_SERIAL;
+				state->params[i].user = 0;
+			}
+		}
+	}
+	spa_node_emit_info(&state->hooks, &state->info);
+	state->info.change_mask = old;
+}
+
+/**
+ * @brief Emit input port info to all listeners
+ *
+ * Same change_mask protocol as null_emit_node_info().
+ *
+ * @param state Null sink state
+ * @param full True to emit every field
+ */
+static void emit_port_info(struct null_state *state, bool full)
+{
+	uint64_t old = full ? state->port_info.change_mask : 0;
+	uint32_t i;
+
+	if (full)
+		state->port_info.change_mask = state->port_info_all;
+	if (state->port_info.change_mask == 0)
+		return;
+
+	if (state->port_info.change_mask & SPA_PORT_CHANGE_MASK_PARAMS) {
+		for (i = 0; i < state->port_info.n_params; i++) {
+			if (state->port_params[i].user > 0) {
+				state->port_params[i].flags ^= SPA_PARAM_INFO_SERIAL;
+				state->port_params[i].user = 0;
+			}
+		}
+	}
+	spa_node_emit_port_info(&state->hooks, SPA_DIRECTION_INPUT, 0, &state->port_info);
+	state->port_info.change_mask = old;
+}
+
+/**
+ * @brief Flag a port param as changed, emitted by the next emit_port_info()
+ */
+static void port_param_changed(struct null_state *state, uint32_t idx, uint32_t flags)
+{
+	state->port_params[idx].flags = (state->port_params[idx].flags & SPA_PARAM_INFO_SERIAL) | flags;
+	state->port_params[idx].user++;
+	state->port_info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+}
+
+/**
+ * @brief Announce a format change on the input port
+ *
+ * Format is readable and Buffers known only while a format is set.
+ */
+static void port_format_changed(struct null_state *state)
+{
+	port_param_changed(state, NULL_PORT_PARAM_Format,
+			   state->have_format ? SPA_PARAM_INFO_READWRITE : SPA_PARAM_INFO_WRITE);
+	port_param_changed(state, NULL_PORT_PARAM_Buffers,
+			   state->have_format ? SPA_PARAM_INFO_READ : 0);
+	emit_port_info(state, false);
+}
+
 /**
  * @brief Add event listener to null sink node
  *
@@ -99,20 +229,134 @@ static int impl_node_add_listener(void *object,
 {
 	struct null_state *state = object;
 
+	struct spa_hook_list save;
+
 	spa_return_val_if_fail(state != NULL, -EINVAL);
 	spa_return_val_if_fail(listener != NULL, -EINVAL);
 
 	/*
 	 * HOOK REGISTRATION:
 	 * ==================
-	 * Register the listener hook in the node's hook list.
-	 * The spa_hook_list ensures thread-safe event delivery.
+	 * Register the listener hook in the node's hook list. The list is
+	 * isolated to the new listener while the full node and port info
+	 * are emitted, so it learns the current state without any enum
+	 * round-trip and existing listeners see nothing twice.
 	 */
-	spa_hook_list_append(&state->hooks, listener, events, data);
+	spa_hook_list_isolate(&state->hooks, &save, listener, events, data);
+
+	null_emit_node_info(state, true);
+	emit_port_info(state, true);
+
+	spa_hook_list_join(&state->hooks, &save);
+
+	return 0;
+}
+
+/**
+ * @brief Complete a batch of pipelined control calls
+ *
+ * Every method of the null sink finishes before it returns, and its
+ * results are emitted in call order. A client can therefore issue many
+ * enum_params/set_param calls back to back and then one sync: when the
+ * result carrying @p seq arrives, all results for earlier calls have
+ * been delivered, so the batch costs one round-trip instead of one per
+ * call.
+ *
+ * @param object Pointer to spa_node interface (cast to null_state)
+ * @param seq Sequence number chosen by the client, echoed in the result
+ *
+ * @return 0 on success
+ */
+static int impl_node_sync(void *object, int seq)
+{
+	struct null_state *state = object;
+
+	spa_return_val_if_fail(state != NULL, -EINVAL);
+
+	spa_node_emit_result(&state->hooks, seq, 0, 0, NULL);
 
 	return 0;
 }
 
+/**
+ * @brief Apply a control-plane change to the data loop
+ *
+ * Inside a ParamBegin/ParamEnd batch the swap is deferred to ParamEnd,
+ * so a renegotiation touching several params and io areas reaches the
+ * data loop as one config instead of one per call.
+ *
+ * @param state Null sink state
+ */
+static void reconfigure(struct null_state *state)
+{
+	if (state->param_batch) {
+		state->reconfigure_pending = true;
+		return;
+	}
+	null_process_select(state);
+}
+
+/*
+ * PARAM BATCH TRANSACTION:
+ * =======================
+ * The data loop only sees the result of a batch at ParamEnd. Until then
+ * the negotiated fields are saved in state->batch, and put back when a
+ * set_param of the batch failed.
+ */
+static void batch_begin(struct null_state *state)
+{
+	struct null_batch *b = &state->batch;
+
+	b->res = 0;
+	b->have_format = state->have_format;
+	b->current_format = state->current_format;
+	b->video_format = state->video_format;
+	b->frame_interval = state->frame_interval;
+	b->frame_stride = state->frame_stride;
+	b->format_serial = state->format_serial;
+	b->encoded_rate = state->encoded_rate;
+	b->encoded_channels = state->encoded_channels;
+	b->encoded_codec = state->encoded_codec;
+	b->process_latency = state->process_latency;
+	b->port_latency[0] = state->port_latency[0];
+	b->port_latency[1] = state->port_latency[1];
+	b->latency = state->latency;
+	b->latency_auto = state->latency_auto;
+
+	state->param_batch = true;
+}
+
+static void batch_rollback(struct null_state *state)
+{
+	struct null_batch *b = &state->batch;
+
+	state->have_format = b->have_format;
+	state->current_format = b->current_format;
+	state->video_format = b->video_format;
+	state->frame_interval = b->frame_interval;
+	state->frame_stride = b->frame_stride;
+	state->format_serial = b->format_serial;
+	state->encoded_rate = b->encoded_rate;
+	state->encoded_channels = b->encoded_channels;
+	state->encoded_codec = b->encoded_codec;
+	state->process_latency = b->process_latency;
+	state->port_latency[0] = b->port_latency[0];
+	state->port_latency[1] = b->port_latency[1];
+	state->latency = b->latency;
+	state->latency_auto = b->latency_auto;
+
+	/* Listeners saw the discarded values, announce the restored ones */
+	null_props_update_info(state);
+	state->params[NULL_NODE_PARAM_Props].user++;
+	state->params[NULL_NODE_PARAM_ProcessLatency].user++;
+	state->info.change_mask |= SPA_NODE_CHANGE_MASK_PARAMS;
+	null_emit_node_info(state, false);
+
+	port_param_changed(state, NULL_PORT_PARAM_Latency, SPA_PARAM_INFO_READWRITE);
+	port_param_changed(state, NULL_PORT_PARAM_ProcessLatency, SPA_PARAM_INFO_READWRITE);
+	port_format_changed(state);
+}
+
 /**
  * @brief Set I/O area for communication with graph engine
  *
@@ -139,7 +383,7 @@ static int impl_node_add_listener(void *object,
  * @note I/O areas are typically set during node configuration
  * @note Areas remain valid until node is destroyed or reconfigured
  */
-static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
+static int node_set_io(void *object, uint32_t id, void *data, size_t size)
 {
 	struct null_state *state = object;
 
@@ -158,11 +402,17 @@ static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
 		 * ================
 		 * This area contains the buffer queue for audio data exchange.
 		 * It includes buffer IDs, buffer status, and queue management.
+		 * The kernels read it from rt, so it is published with the
+		 * next config, at ParamEnd when batched.
 		 */
 		if (size >= sizeof(struct spa_io_buffers))
 			state->io = data;
 		else
 			state->io = NULL;
+		/* A removed area can't wait for ParamEnd, the host may free it */
+		if (state->io == NULL && state->param_batch)
+			null_process_set_buffers(state);
+		reconfigure(state);
 		break;
 
 	case SPA_IO_RateMatch:
@@ -178,6 +428,40 @@ static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
 			state->rate_match = NULL;
 		break;
 
+	case SPA_IO_Position:
+		/*
+		 * POSITION I/O:
+		 * =============
+		 * Graph clock and current quantum. Control sinks use the
+		 * quantum to detect events scheduled past the end of a cycle.
+		 * The kernels read it from rt, like the buffer area.
+		 */
+		if (size >= sizeof(struct spa_io_position))
+			state->position = data;
+		else
+			state->position = NULL;
+		if (state->position == NULL && state->param_batch)
+			null_process_set_buffers(state);
+		reconfigure(state);
+		break;
+
+	case SPA_IO_Clock:
+		/*
+		 * CLOCK I/O:
+		 * ==========
+		 * Driver clock with the wakeup time of the current cycle,
+		 * used for the scheduling latency and jitter statistics.
+		 * The kernels read it from rt, like the buffer area.
+		 */
+		if (size >= sizeof(struct spa_io_clock))
+			state->clock = data;
+		else
+			state->clock = NULL;
+		if (state->clock == NULL && state->param_batch)
+			null_process_set_buffers(state);
+		reconfigure(state);
+		break;
+
 	default:
 		/*
 		 * UNSUPPORTED I/O TYPES:
@@ -191,6 +475,17 @@ static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
 	return 0;
 }
 
+static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
+{
+	int res;
+
+	NULL_PROBE(set_io_entry, object, id, data, size);
+	res = node_set_io(object, id, data, size);
+	NULL_PROBE(set_io_exit, object, id, res);
+
+	return res;
+}
+
 /**
  * @brief Send command to null sink node
  *
@@ -215,9 +510,36 @@ static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
  * @note Start command begins buffer processing
  * @note Suspend command stops processing but preserves state
  */
-static int impl_node_send_command(void *object, const struct spa_command *command)
+/* Defined with the buffer memory helpers below */
+static void release_buffers(struct null_state *state, bool drop);
+static void remap_buffers(struct null_state *state);
+
+static int do_flush(struct spa_loop *loop, bool async, uint32_t seq,
+                    const void *data, size_t size, void *user_data)
+{
+	struct null_state *state = user_data;
+	struct spa_io_buffers *io = state->rt.io;
+
+	if (io != NULL && io->status == SPA_STATUS_HAVE_DATA) {
+		io->buffer_id = SPA_ID_INVALID;
+		io->status = SPA_STATUS_NEED_DATA;
+	}
+
+	/* A flushed stream restarts at a frame and timing boundary */
+	state->encoded_skip = 0;
+	state->last_frame_time = 0;
+	state->last_interval = 0;
+	state->timing.last_nsec = 0;
+
+	return 0;
+}
+
+static int node_send_command(void *object, const struct spa_command *command)
 {
 	struct null_state *state = object;
+	uint64_t frames, buffers;
+	bool suspend;
+	int res;
 
 	spa_return_val_if_fail(state != NULL, -EINVAL);
 	spa_return_val_if_fail(command != NULL, -EINVAL);
@@ -241,10 +563,74 @@ static int impl_node_send_command(void *object, const struct spa_command *comman
 			return -EIO;
 		}
 
+		/* Counters are per-thread, so they are opened on the data loop */
+		if (state->perf_enabled)
+			null_perf_open(state);
+
+		/* Mappings released by a Suspend are made again */
+		remap_buffers(state);
+
+		/* Make everything process() touches resident before the first cycle */
+		if (state->mlock)
+			null_memory_lock(state);
+
 		state->started = true;
+		null_process_select(state);
 		spa_log_info(state->log, "null-sink %p: started", state);
 		break;
 
+	case SPA_NODE_COMMAND_Flush:
+		/*
+		 * FLUSH COMMAND:
+		 * =============
+		 * Drop the pending buffer and the per-stream parser state on
+		 * the data loop, then format the queued diagnostics. Both
+		 * are bounded: one io area and at most NULL_RTLOG_SIZE
+		 * records. Counters and configuration are kept.
+		 */
+		if (state->data_loop != NULL)
+			spa_loop_invoke(state->data_loop, do_flush, 0, NULL, 0, true, state);
+		else
+			do_flush(NULL, false, 0, NULL, 0, state);
+		null_rtlog_drain(state);
+		spa_log_debug(state->log, "null-sink %p: flushed", state);
+		break;
+
+	case SPA_NODE_COMMAND_ParamBegin:
+		/*
+		 * PARAM BATCH:
+		 * ===========
+		 * set_param and set_io between ParamBegin and ParamEnd are
+		 * validated and stored as usual, but the data loop keeps
+		 * running the previous config until ParamEnd swaps in the
+		 * result of the whole batch (see reconfigure()).
+		 *
+		 * The batch is a transaction: if any set_param in it
+		 * failed, ParamEnd restores the params saved here and
+		 * returns that error. io areas set meanwhile are kept.
+		 */
+		if (!state->param_batch)
+			batch_begin(state);
+		break;
+
+	case SPA_NODE_COMMAND_ParamEnd:
+		if (!state->param_batch)
+			break;
+		state->param_batch = false;
+
+		if ((res = state->batch.res) < 0) {
+			batch_rollback(state);
+			spa_log_warn(state->log, "null-sink %p: param batch discarded: %s",
+				     state, spa_strerror(res));
+		}
+		if (state->reconfigure_pending) {
+			state->reconfigure_pending = false;
+			null_process_select(state);
+		}
+		if (res < 0)
+			return res;
+		break;
+
 	case SPA_NODE_COMMAND_Suspend:
 	case SPA_NODE_COMMAND_Pause:
 		/*
@@ -252,9 +638,57 @@ static int impl_node_send_command(void *object, const struct spa_command *comman
 		 * ======================
 		 * Stop processing but maintain configuration state.
 		 * The node can be restarted without reconfiguration.
+		 * Once null_process_select() returns the data loop runs the
+		 * idle kernel, so the counters read below are final.
+		 *
+		 * Pause keeps everything hot: buffers stay mapped, perf
+		 * counters open and memory locked, so Start resumes without
+		 * a syscall or allocation. Suspend is for sinks that stay
+		 * idle for long and releases all of that, see below.
 		 */
+		suspend = SPA_NODE_COMMAND_ID(command) == SPA_NODE_COMMAND_Suspend;
+
 		state->started = false;
-		spa_log_info(state->log, "null-sink %p: suspended", state);
+		null_process_select(state);
+
+		frames = state->frame_count;
+		buffers = state->buffer_count;
+		if (state->group)
+			null_group_get_stats(state, &frames, &buffers);
+
+		null_shm_stopped(state);
+		null_rtlog_drain(state);
+		null_timing_log(state);
+		null_perf_log(state);
+
+		spa_log_info(state->log, "null-sink %p: %s after %" PRIu64
+			     " frames in %" PRIu64 " buffers", state,
+			     suspend ? "suspended" : "paused", frames, buffers);
+		if (state->encoded_samples > 0)
+			spa_log_info(state->log, "null-sink %p: %" PRIu64 " payload bytes, "
+				     "%" PRIu64 " samples, %" PRIu64 " bit/s", state,
+				     state->encoded_payload, state->encoded_samples,
+				     null_encoded_bitrate(state));
+
+		if (!suspend)
+			break;
+
+		/*
+		 * SUSPEND RELEASE:
+		 * ===============
+		 * The sink's own mappings of the buffer memory, the perf
+		 * fds and their mapped pages, and the locked pages are
+		 * released. The timing statistics were logged above and
+		 * restart from zero. The buffer table belongs to the host
+		 * and is kept, as the host may Start again without a new
+		 * use_buffers; Start maps, opens and locks everything
+		 * again. The stats segment stays mapped so monitors keep
+		 * seeing the stopped sink.
+		 */
+		release_buffers(state, false);
+		null_perf_close(state);
+		null_memory_unlock(state);
+		null_timing_reset(state);
 		break;
 
 	default:
@@ -271,6 +705,70 @@ static int impl_node_send_command(void *object, const struct spa_command *comman
 	return 0;
 }
 
+static int impl_node_send_command(void *object, const struct spa_command *command)
+{
+	struct null_state *state = object;
+	int res;
+
+	NULL_PROBE(send_command_entry, state,
+		   command ? SPA_NODE_COMMAND_ID(command) : SPA_ID_INVALID);
+	res = node_send_command(object, command);
+	NULL_PROBE(send_command_exit, state, res, state ? state->started : 0);
+
+	return res;
+}
+
+/**
+ * @brief Validate and apply a raw audio format
+ *
+ * Shared by set_param(Format) and the audio.* factory properties. With a
+ * preset format only that format is accepted.
+ *
+ * @return 0 on success, -EINVAL if the null sink can't take the format
+ */
+static int apply_raw_format(struct null_state *state, const struct spa_audio_info_raw *raw)
+{
+	int res;
+
+	/*
+	 * FORMAT VALIDATION:
+	 * ==================
+	 * Validate format parameters against null sink capabilities.
+	 * Null sink is very permissive since it just drops buffers.
+	 */
+	if ((res = null_audio_check_raw(state->log, "null-sink", state, raw)) < 0)
+		return res;
+
+	/* Only the preset is enumerated, so nothing else is accepted either */
+	if (state->preset &&
+	    (raw->format != state->preset_format.format ||
+	     raw->rate != state->preset_format.rate ||
+	     raw->channels != state->preset_format.channels)) {
+		spa_log_error(state->log, "null-sink %p: format %s %d channels %d Hz "
+			      "doesn't match the preset", state,
+			      spa_debug_type_find_name(spa_type_audio_format, raw->format),
+			      raw->channels, raw->rate);
+		return -EINVAL;
+	}
+
+	/*
+	 * APPLY FORMAT:
+	 * =============
+	 * Store the validated format and mark node as configured.
+	 */
+	state->current_format.media_type = SPA_MEDIA_TYPE_audio;
+	state->current_format.media_subtype = SPA_MEDIA_SUBTYPE_raw;
+	state->current_format.info.raw = *raw;
+	state->frame_stride = null_audio_frame_stride(raw);
+	state->have_format = true;
+
+	spa_log_info(state->log, "null-sink %p: format set to %d channels, %d Hz, %s",
+		    state, raw->channels, raw->rate,
+		    spa_debug_type_find_name(spa_type_audio_format, raw->format));
+
+	return 0;
+}
+
 /**
  * @brief Set parameter on null sink node
  *
@@ -302,8 +800,8 @@ static int impl_node_send_command(void *object, const struct spa_command *comman
  * @note Format parameter must be set before starting node
  * @note Setting format may trigger buffer reconfiguration
  */
-static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
-                              const struct spa_pod *param)
+static int node_set_param(void *object, uint32_t id, uint32_t flags,
+                         const struct spa_pod *param)
 {
 	struct null_state *state = object;
 	int res = 0;
@@ -328,7 +826,17 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 		 * - Sample format (float32, int16, etc.)
 		 * - Channel layout (surround sound mapping)
 		 */
-		if (param == NULL) {
+		if (param == NULL && state->preset) {
+			/*
+			 * RESTORE PRESET:
+			 * ==============
+			 * A preset sink is never unconfigured, clearing the
+			 * format falls back to the one from the properties.
+			 */
+			spa_zero(state->current_format);
+			if ((res = apply_raw_format(state, &state->preset_format)) < 0)
+				return res;
+		} else if (param == NULL) {
 			/*
 			 * CLEAR FORMAT:
 			 * =============
@@ -336,8 +844,38 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 			 * This returns the node to unconfigured state.
 			 */
 			state->have_format = false;
+			state->frame_stride = 0;
 			spa_zero(state->current_format);
+			spa_zero(state->video_format);
 			spa_log_info(state->log, "null-sink %p: format cleared", state);
+		} else if (state->kind == NULL_SINK_VIDEO) {
+			/*
+			 * SET VIDEO FORMAT:
+			 * ================
+			 * Video sinks only need the framerate, for the frame
+			 * interval jitter statistics.
+			 */
+			struct spa_video_info info;
+
+			if ((res = null_video_parse_format(state, param, &info)) < 0)
+				return res;
+
+			state->video_format = info;
+			state->frame_interval = null_video_frame_interval(&info);
+			state->frame_stride = 0;
+			state->have_format = true;
+		} else if (state->kind == NULL_SINK_CONTROL) {
+			/*
+			 * SET CONTROL FORMAT:
+			 * ==================
+			 * application/control has no parameters, the events
+			 * carry their own types.
+			 */
+			if ((res = null_control_parse_format(state, param)) < 0)
+				return res;
+
+			state->frame_stride = 0;
+			state->have_format = true;
 		} else {
 			/*
 			 * SET FORMAT:
@@ -354,9 +892,30 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 				return res;
 			}
 
-			/* Validate media type - must be audio */
-			if (info.media_type != SPA_MEDIA_TYPE_audio ||
+			/*
+			 * ENCODED FORMATS:
+			 * ===============
+			 * Compressed and IEC958 streams are only framed, never
+			 * decoded, so they have no frame stride.
+			 */
+			if (info.media_type == SPA_MEDIA_TYPE_audio &&
 			    info.media_subtype != SPA_MEDIA_SUBTYPE_raw) {
+				if (state->preset) {
+					spa_log_error(state->log, "null-sink %p: only the preset "
+						      "raw format is accepted", state);
+					return -EINVAL;
+				}
+				if ((res = null_encoded_parse_format(state, param, &info)) < 0)
+					return res;
+
+				state->current_format = info;
+				state->frame_stride = 0;
+				state->have_format = true;
+				goto done;
+			}
+
+			/* Validate media type - must be audio */
+			if (info.media_type != SPA_MEDIA_TYPE_audio) {
 				spa_log_error(state->log, "null-sink %p: unsupported media type %d/%d",
 					     state, info.media_type, info.media_subtype);
 				return -EINVAL;
@@ -369,45 +928,59 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 				return res;
 			}
 
-			/*
-			 * FORMAT VALIDATION:
-			 * ==================
-			 * Validate format parameters against null sink capabilities.
-			 * Null sink is very permissive since it just drops buffers.
-			 */
-			if (info.info.raw.channels == 0 || info.info.raw.channels > 64) {
-				spa_log_error(state->log, "null-sink %p: invalid channel count %d",
-					     state, info.info.raw.channels);
-				return -EINVAL;
-			}
-
-			if (info.info.raw.rate == 0 || info.info.raw.rate > 192000) {
-				spa_log_error(state->log, "null-sink %p: invalid sample rate %d",
-					     state, info.info.raw.rate);
-				return -EINVAL;
-			}
+			if ((res = apply_raw_format(state, &info.info.raw)) < 0)
+				return res;
+		}
+done:
+		/*
+		 * APPLY TO THE DATA LOOP:
+		 * ======================
+		 * Nothing above is read by process(). The new kernel and
+		 * format fields reach it in one swap between two cycles,
+		 * or at ParamEnd when batched, and the per-format counters
+		 * restart with it.
+		 */
+		state->format_serial++;
+		reconfigure(state);
 
-			/*
-			 * APPLY FORMAT:
-			 * =============
-			 * Store the validated format and mark node as configured.
-			 */
-			state->current_format = info;
-			state->have_format = true;
+		/* The port Format and the buffer requirements follow */
+		port_format_changed(state);
+		break;
 
-			spa_log_info(state->log, "null-sink %p: format set to %d channels, %d Hz, %s",
-				    state, info.info.raw.channels, info.info.raw.rate,
-				    spa_debug_type_find_name(spa_type_audio_format, info.info.raw.format));
+	case SPA_PARAM_Latency:
+	case SPA_PARAM_ProcessLatency:
+		/*
+		 * LATENCY PARAMETERS:
+		 * ==================
+		 * Emulated device latency and upstream latency, see
+		 * null-latency.c.
+		 */
+		res = null_latency_set_param(state, id, param);
+		if (res < 0)
+			break;
+		if (id == SPA_PARAM_ProcessLatency)
+			reconfigure(state);
+
+		port_param_changed(state, NULL_PORT_PARAM_Latency, SPA_PARAM_INFO_READWRITE);
+		if (id == SPA_PARAM_ProcessLatency) {
+			port_param_changed(state, NULL_PORT_PARAM_ProcessLatency,
+					   SPA_PARAM_INFO_READWRITE);
+			state->params[NULL_NODE_PARAM_ProcessLatency].user++;
+			state->info.change_mask |= SPA_NODE_CHANGE_MASK_PARAMS;
+			null_emit_node_info(state, false);
 		}
+		emit_port_info(state, false);
+		break;
 
+	case SPA_PARAM_Props:
 		/*
-		 * EMIT FORMAT CHANGE EVENT:
-		 * =========================
-		 * Notify all listeners that the format has changed.
-		 * This allows the graph to reconfigure connections.
+		 * RUNTIME PROPS:
+		 * =============
+		 * Requested latency and auto mode, see null-props.c.
 		 */
-		spa_node_call(&state->hooks, struct spa_node_events, param_changed,
-			     0, id, param);
+		res = null_props_set(state, param);
+		if (res >= 0)
+			reconfigure(state);
 		break;
 
 	default:
@@ -424,6 +997,94 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 	return res;
 }
 
+static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
+                              const struct spa_pod *param)
+{
+	struct null_state *state = object;
+	int res;
+
+	NULL_PROBE(set_param_entry, state, id, param ? SPA_POD_SIZE(param) : 0);
+	res = node_set_param(object, id, flags, param);
+
+	/* A failed call fails the whole batch at ParamEnd */
+	if (res < 0 && state != NULL && state->param_batch && state->batch.res == 0)
+		state->batch.res = res;
+
+	NULL_PROBE(set_param_exit, state, id, res,
+		   state ? state->current_format.media_subtype : 0,
+		   state ? state->current_format.info.raw.format : 0);
+
+	return res;
+}
+
+/**
+ * @brief Build the accepted format with @p index
+ *
+ * Shared by the port EnumFormat param and the node-level Format
+ * enumeration.
+ *
+ * @return 1 if a format was built, 0 when @p index is past the last one
+ */
+static int enum_format(struct null_state *state, uint32_t id, uint32_t index,
+                       struct spa_pod_builder *b, struct spa_pod **param)
+{
+	/*
+	 * FORMAT ENUMERATION:
+	 * ==================
+	 * Advertise all audio formats that the null sink can accept.
+	 * Since we just drop buffers, we can support almost anything.
+	 */
+	if (state->kind == NULL_SINK_VIDEO)
+		return null_video_enum_format(state, id, index, b, param);
+	if (state->kind == NULL_SINK_CONTROL)
+		return null_control_enum_format(state, id, index, b, param);
+
+	/* A preset format from the factory properties is the only one */
+	if (state->preset) {
+		if (index > 0)
+			return 0;
+		*param = spa_format_audio_raw_build(b, id, &state->preset_format);
+		return 1;
+	}
+
+	/* Encoded and IEC958 passthrough formats follow raw */
+	if (index > 0)
+		return null_encoded_enum_format(state, id, index - 1, b, param);
+
+	/*
+	 * BUILD FORMAT PARAMETER:
+	 * =======================
+	 * Create a spa_pod describing supported audio format.
+	 * Use ranges to indicate flexibility in format parameters.
+	 */
+	*param = spa_format_audio_raw_build(b, id,
+		&SPA_AUDIO_INFO_RAW_INIT(
+			.format = SPA_AUDIO_FORMAT_F32P,  /* Prefer planar float */
+			.channels = 2,                     /* Default stereo */
+			.rate = 48000                      /* Default 48kHz */
+		));
+	return 1;
+}
+
+/**
+ * @brief Build the negotiated format, for the port Format param
+ *
+ * @return 1 if a format was built, 0 on failure
+ */
+static int build_format(struct null_state *state, uint32_t id,
+                        struct spa_pod_builder *b, struct spa_pod **param)
+{
+	if (state->kind == NULL_SINK_VIDEO)
+		return null_video_build_format(state, id, b, param);
+	if (state->kind == NULL_SINK_CONTROL)
+		return null_control_enum_format(state, id, 0, b, param);
+	if (state->current_format.media_subtype != SPA_MEDIA_SUBTYPE_raw)
+		return null_encoded_build_format(state, id, b, param);
+
+	*param = spa_format_audio_raw_build(b, id, &state->current_format.info.raw);
+	return *param != NULL;
+}
+
 /**
  * @brief Enumerate supported parameters for null sink node
  *
@@ -445,11 +1106,11 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
  * @param num Maximum number of parameters to return
  * @param filter Optional filter to constrain results
  *
- * @return Number of parameters returned
- * @return 0 if no parameters available
+ * @return 0 when enumeration is complete
  * @return <0 on error
  *
  * @note Most important parameter is Format (supported audio formats)
+ * @note Parameters not matching @p filter are skipped
  * @note Results are returned through async result callback
  */
 static int impl_node_enum_params(void *object, int seq,
@@ -469,6 +1130,11 @@ static int impl_node_enum_params(void *object, int seq,
 	result.id = id;
 	result.next = start;
 
+next:
+	result.index = result.next++;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
 	/*
 	 * PARAMETER TYPE ENUMERATION:
 	 * ===========================
@@ -480,34 +1146,23 @@ static int impl_node_enum_params(void *object, int seq,
 		/*
 		 * FORMAT ENUMERATION:
 		 * ==================
-		 * Advertise all audio formats that the null sink can accept.
-		 * Since we just drop buffers, we can support almost anything.
+		 * The input port advertises the list as EnumFormat, the
+		 * same list stays available here for callers that
+		 * enumerate on the node.
 		 */
-		if (start == 0 && count < num) {
-			spa_pod_builder_init(&b, buffer, sizeof(buffer));
+		if (!enum_format(state, id, result.index, &b, &param))
+			return 0;
+		break;
 
-			/*
-			 * BUILD FORMAT PARAMETER:
-			 * =======================
-			 * Create a spa_pod describing supported audio format.
-			 * Use ranges to indicate flexibility in format parameters.
-			 */
-			param = spa_format_audio_raw_build(&b, SPA_PARAM_Format,
-				&SPA_AUDIO_INFO_RAW_INIT(
-					.format = SPA_AUDIO_FORMAT_F32P,  /* Prefer planar float */
-					.channels = 2,                     /* Default stereo */
-					.rate = 48000                      /* Default 48kHz */
-				));
+	case SPA_PARAM_ProcessLatency:
+		if (!null_latency_enum_param(state, id, result.index, false, &b, &param))
+			return 0;
+		break;
 
-			/*
-			 * EMIT PARAMETER RESULT:
-			 * =====================
-			 * Send the format parameter back to the requesting component.
-			 */
-			spa_node_call(&state->hooks, struct spa_node_events, result,
-				     seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
-			count++;
-		}
+	case SPA_PARAM_PropInfo:
+	case SPA_PARAM_Props:
+		if (!null_props_enum(state, id, result.index, &b, &param))
+			return 0;
 		break;
 
 	default:
@@ -516,10 +1171,29 @@ static int impl_node_enum_params(void *object, int seq,
 		 * ============================
 		 * Return 0 to indicate no parameters available for this type.
 		 */
-		break;
+		return 0;
 	}
 
-	return count;
+	/*
+	 * APPLY FILTER:
+	 * ============
+	 * Intersect the parameter with the caller's filter. Parameters that
+	 * don't match are skipped and the next index is tried.
+	 */
+	if (spa_pod_filter(&b, &result.param, param, filter) < 0)
+		goto next;
+
+	/*
+	 * EMIT PARAMETER RESULT:
+	 * =====================
+	 * Send the parameter back to the requesting component.
+	 */
+	spa_node_emit_result(&state->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
+
+	if (++count != num)
+		goto next;
+
+	return 0;
 }
 
 /**
@@ -539,7 +1213,7 @@ static int impl_node_enum_params(void *object, int seq,
  *
  * BUFFER PROCESSING PROTOCOL:
  * ==========================
- * 1. Check I/O area for available buffers
+ * 1. Check I/O area for available buffers (io->status == HAVE_DATA)
  * 2. Process buffers according to node function
  * 3. Update buffer status and queue positions
  * 4. Handle timing and synchronization
@@ -548,11 +1222,20 @@ static int impl_node_enum_params(void *object, int seq,
  * For null sink: Accept buffers and immediately mark them as consumed
  * without actually processing the audio data (drop buffers).
  *
+ * ASYNC SCHEDULING:
+ * ================
+ * When the node is flagged SPA_NODE_FLAG_ASYNC the graph does not wait
+ * for the sink before starting the next cycle; the io area then holds
+ * what the peer produced in the previous cycle. A buffer is therefore
+ * only consumed when the peer flagged it with SPA_STATUS_HAVE_DATA, and
+ * io->status is handed back as SPA_STATUS_NEED_DATA afterwards, so a
+ * stale io area is never counted twice.
+ *
  * @param object Pointer to spa_node interface (cast to null_state)
  *
- * @return SPA_STATUS_OK if processing completed successfully
- * @return SPA_STATUS_NEED_DATA if more data needed
- * @return SPA_STATUS_HAVE_DATA if data is available for output
+ * @return SPA_STATUS_HAVE_DATA if a buffer was consumed
+ * @return SPA_STATUS_NEED_DATA if no new buffer was available
+ * @return SPA_STATUS_OK if the node is not running
  * @return <0 on error
  *
  * @note This function runs in real-time audio thread context
@@ -562,139 +1245,28 @@ static int impl_node_enum_params(void *object, int seq,
 static int impl_node_process(void *object)
 {
 	struct null_state *state = object;
-	struct spa_io_buffers *io;
-	struct spa_buffer *buf;
+	int res;
 
 	spa_return_val_if_fail(state != NULL, -EINVAL);
 
-	/*
-	 * CHECK NODE STATE:
-	 * ================
-	 * Only process if node is properly configured and started.
-	 */
-	if (!state->started || !state->have_format)
-		return SPA_STATUS_OK;
+	/* Arguments are only evaluated while a tracer is attached */
+	NULL_PROBE(process_entry, state,
+		   state->rt.io ? state->rt.io->buffer_id : SPA_ID_INVALID,
+		   state->rt.io ? state->rt.io->status : 0,
+		   null_probe_chunk_size(state));
 
 	/*
-	 * GET I/O AREA:
-	 * ============
-	 * The I/O area contains the buffer queue for communication
-	 * with the graph engine.
-	 */
-	io = state->io;
-	if (spa_unlikely(io == NULL))
-		return SPA_STATUS_OK;
-
-	/*
-	 * CHECK BUFFER AVAILABILITY:
+	 * DISPATCH TO PROCESS KERNEL:
 	 * ==========================
-	 * The buffer_id field indicates which buffer is ready for processing.
-	 * SPA_ID_INVALID means no buffer is available.
-	 */
-	if (spa_unlikely(io->buffer_id == SPA_ID_INVALID))
-		return SPA_STATUS_OK;
-
-	/*
-	 * VALIDATE BUFFER ID:
-	 * ==================
-	 * Ensure buffer ID is within valid range to prevent crashes.
+	 * The node state, format and features only change on the control
+	 * plane, so the matching kernel was already selected there (see
+	 * null-process.c) and none of it is re-checked per cycle.
 	 */
-	if (spa_unlikely(io->buffer_id >= MAX_BUFFERS)) {
-		spa_log_warn(state->log, "null-sink %p: invalid buffer id %d",
-			    state, io->buffer_id);
-		io->buffer_id = SPA_ID_INVALID;
-		return SPA_STATUS_OK;
-	}
-
-	/*
-	 * GET BUFFER REFERENCE:
-	 * ====================
-	 * The buffer contains audio data and metadata.
-	 * For null sink, we don't actually read the data.
-	 */
-	buf = io->buffers[io->buffer_id];
-	if (spa_unlikely(buf == NULL)) {
-		spa_log_warn(state->log, "null-sink %p: null buffer", state);
-		io->buffer_id = SPA_ID_INVALID;
-		return SPA_STATUS_OK;
-	}
-
-	/*
-	 * PROCESS BUFFER (NULL SINK IMPLEMENTATION):
-	 * ==========================================
-	 * For a null sink, "processing" means accepting the buffer
-	 * and immediately discarding it. In a real sink, this would
-	 * involve sending data to hardware or writing to a file.
-	 */
-
-	/* Extract buffer metadata for statistics */
-	if (buf->datas[0].chunk) {
-		uint32_t size = buf->datas[0].chunk->size;
-		uint32_t frames = size / (state->current_format.info.raw.channels *
-		                         sizeof(float)); /* Assume float for simplicity */
-
-		/* Update processing statistics */
-		state->frame_count += frames;
-		state->buffer_count++;
-
-		/* Log occasionally for debugging (avoid flooding logs) */
-		if (spa_unlikely(state->buffer_count % 1000 == 0)) {
-			spa_log_trace(state->log,
-				     "null-sink %p: dropped %lu frames in %lu buffers",
-				     state, state->frame_count, state->buffer_count);
-		}
-	}
-
-	/*
-	 * MARK BUFFER AS CONSUMED:
-	 * =======================
-	 * Set buffer_id to INVALID to indicate we're done with this buffer.
-	 * The graph engine will recycle the buffer for the next cycle.
-	 */
-	io->buffer_id = SPA_ID_INVALID;
-
-	/*
-	 * HANDLE RATE MATCHING:
-	 * ====================
-	 * If rate matching is enabled, update timing information.
-	 * This helps maintain synchronization across the graph.
-	 */
-	if (state->rate_match) {
-		/* For null sink, we don't need to adjust timing */
-		/* Real sinks would update rate_match based on hardware timing */
-	}
-
-	/*
-	 * RETURN PROCESSING STATUS:
-	 * ========================
-	 * SPA_STATUS_OK indicates successful processing.
-	 * The graph will continue with the next processing cycle.
-	 */
-	return SPA_STATUS_OK;
-}
-
-/**
- * @brief Get information about null sink node
- *
- * This function returns static information about the node's capabilities
- * and current state. It's used by the graph for routing decisions.
- *
- * @param object Pointer to spa_node interface (cast to null_state)
- * @param info Pointer to store node information
- *
- * @return 0 on success
- *
- * @note Information includes supported parameters, port counts, and properties
- */
-static int impl_node_get_info(void *object, const struct spa_node_info **info)
-{
-	struct null_state *state = object;
+	res = state->rt.process(state);
 
-	spa_return_val_if_fail(state != NULL, -EINVAL);
-	spa_return_val_if_fail(info != NULL, -EINVAL);
+	NULL_PROBE(process_exit, state, res, state->buffer_count);
 
-	*info = &state->info;
-	return 0;
+	return res;
 }
 
 /**
@@ -734,36 +1306,6 @@ static int impl_node_enum_ports(void *object, int seq,
 	return 0;
 }
 
-/**
- * @brief Get information about specific port
- *
- * Returns detailed information about a port, including supported
- * parameters and current configuration.
- *
- * @param object Pointer to spa_node interface (cast to null_state)
- * @param direction Port direction (input/output)
- * @param port_id Port index
- * @param info Pointer to store port information
- *
- * @return 0 on success
- * @return -EINVAL if port doesn't exist
- */
-static int impl_node_get_port_info(void *object,
-                                  enum spa_direction direction, uint32_t port_id,
-                                  const struct spa_port_info **info)
-{
-	struct null_state *state = object;
-
-	spa_return_val_if_fail(state != NULL, -EINVAL);
-	spa_return_val_if_fail(info != NULL, -EINVAL);
-
-	if (direction != SPA_DIRECTION_INPUT || port_id != 0)
-		return -EINVAL;
-
-	*info = &state->port_info;
-	return 0;
-}
-
 /**
  * @brief Enumerate parameters for specific port
  *
@@ -779,15 +1321,101 @@ static int impl_node_get_port_info(void *object,
  * @param num Maximum parameters to return
  * @param filter Optional filter for results
  *
- * @return Number of parameters returned
+ * @return 0 when enumeration is complete
+ * @return -EINVAL if the port doesn't exist
+ *
+ * @note SPA_PARAM_Buffers is only enumerated once a format is set
  */
 static int impl_node_enum_port_params(void *object, int seq,
                                      enum spa_direction direction, uint32_t port_id,
                                      uint32_t id, uint32_t start, uint32_t num,
                                      const struct spa_pod *filter)
 {
-	/* Port parameters follow similar pattern to node parameters */
-	/* Implementation details omitted for brevity */
+	struct null_state *state = object;
+	struct spa_pod *param;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_result_node_params result;
+	uint32_t count = 0, blocks, size, data_types;
+
+	spa_return_val_if_fail(state != NULL, -EINVAL);
+	spa_return_val_if_fail(num != 0, -EINVAL);
+
+	if (direction != SPA_DIRECTION_INPUT || port_id != 0)
+		return -EINVAL;
+
+	result.id = id;
+	result.next = start;
+
+next:
+	result.index = result.next++;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (id) {
+	case SPA_PARAM_EnumFormat:
+		if (!enum_format(state, id, result.index, &b, &param))
+			return 0;
+		break;
+
+	case SPA_PARAM_Format:
+		/* The negotiated format, once there is one */
+		if (!state->have_format || result.index > 0)
+			return 0;
+		if (!build_format(state, id, &b, &param))
+			return 0;
+		break;
+
+	case SPA_PARAM_Buffers:
+		/*
+		 * BUFFER REQUIREMENTS:
+		 * ===================
+		 * Only known once a format is set. The data types are the
+		 * ones use_buffers handles without copying: MemFd (mapped
+		 * once), MemPtr, and DmaBuf for video, which is never mapped.
+		 */
+		if (!state->have_format || result.index > 0)
+			return 0;
+
+		blocks = 1;
+		size = 8192;
+		if (state->frame_stride != 0) {
+			if (SPA_AUDIO_FORMAT_IS_PLANAR(state->current_format.info.raw.format))
+				blocks = state->current_format.info.raw.channels;
+			size = DEFAULT_FRAMES * state->frame_stride;
+		}
+
+		data_types = (1 << SPA_DATA_MemFd) | (1 << SPA_DATA_MemPtr);
+		if (state->kind == NULL_SINK_VIDEO)
+			data_types |= (1 << SPA_DATA_DmaBuf);
+
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_ParamBuffers, id,
+			SPA_PARAM_BUFFERS_buffers,  SPA_POD_CHOICE_RANGE_Int(2, 1, MAX_BUFFERS),
+			SPA_PARAM_BUFFERS_blocks,   SPA_POD_Int(blocks),
+			SPA_PARAM_BUFFERS_size,     SPA_POD_CHOICE_RANGE_Int(size, 1, INT32_MAX),
+			SPA_PARAM_BUFFERS_stride,   SPA_POD_Int(state->frame_stride),
+			SPA_PARAM_BUFFERS_dataType, SPA_POD_CHOICE_FLAGS_Int(data_types));
+		break;
+
+	case SPA_PARAM_Latency:
+	case SPA_PARAM_ProcessLatency:
+		if (!null_latency_enum_param(state, id, result.index, true, &b, &param))
+			return 0;
+		break;
+
+	default:
+		return 0;
+	}
+
+	if (spa_pod_filter(&b, &result.param, param, filter) < 0)
+		goto next;
+
+	spa_node_emit_result(&state->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
+
+	if (++count != num)
+		goto next;
+
 	return 0;
 }
 
@@ -815,12 +1443,140 @@ static int impl_node_set_port_param(void *object,
 	return impl_node_set_param(object, id, flags, param);
 }
 
+/*
+ * BUFFER MEMORY:
+ * =============
+ * Buffer data arrives in one of three forms:
+ *
+ * - SPA_DATA_MemPtr: already mapped in our address space by the host
+ * - SPA_DATA_MemFd:  a shared memory fd from another process, mapped
+ *                    here when the host did not map it already
+ * - SPA_DATA_DmaBuf: device memory, never mapped (only chunk sizes are
+ *                    read, see null-video.c)
+ *
+ * MemFd mappings are created once in use_buffers and removed when the
+ * buffers are replaced or the handle is cleared, so the process kernels
+ * never call mmap. With the null.mmap-populate property the mapping is
+ * made with MAP_POPULATE, so even the first touch of a page in the data
+ * loop does not fault.
+ *
+ * The kernels read the table from rt, so the table without the released
+ * memory is published to the data loop first and the old mappings are
+ * only removed after that.
+ *
+ * @param state Null sink state
+ * @param drop  True to also empty the buffer table, false to only release
+ *              the own mappings and keep the host's buffers
+ */
+static void release_buffers(struct null_state *state, bool drop)
+{
+	struct null_mem old[MAX_BUFFERS];
+	uint32_t i, n_old = state->n_buffers;
+
+	/* munmap also drops the locks of own mappings */
+	for (i = 0; i < n_old; i++) {
+		old[i] = state->mems[i];
+		if (drop || old[i].map != NULL)
+			spa_zero(state->mems[i]);
+		if (drop)
+			state->buffers[i] = NULL;
+	}
+	if (drop)
+		state->n_buffers = 0;
+	null_process_set_buffers(state);
+
+	for (i = 0; i < n_old; i++) {
+		if (old[i].map != NULL)
+			munmap(old[i].map, old[i].map_size);
+	}
+}
+
+static void clear_buffers(struct null_state *state)
+{
+	release_buffers(state, true);
+}
+
+static int map_buffer(struct null_state *state, uint32_t id, struct spa_buffer *buf)
+{
+	struct null_mem *m = &state->mems[id];
+	struct spa_data *d;
+	long page_size;
+	off_t offset;
+	size_t skew;
+
+	spa_zero(*m);
+	if (buf->n_datas == 0)
+		return 0;
+
+	/* Only the first plane is ever read by the process kernels */
+	d = &buf->datas[0];
+
+	switch (d->type) {
+	case SPA_DATA_MemPtr:
+		m->data = d->data;
+		return 0;
+
+	case SPA_DATA_DmaBuf:
+		return 0;
+
+	case SPA_DATA_MemFd:
+		if (d->data != NULL) {
+			m->data = d->data;
+			return 0;
+		}
+		if (!SPA_FLAG_IS_SET(d->flags, SPA_DATA_FLAG_READABLE) || d->fd < 0)
+			return 0;
+
+		/* mmap offsets must be page aligned */
+		page_size = sysconf(_SC_PAGESIZE);
+		offset = SPA_ROUND_DOWN_N((off_t) d->mapoffset, (off_t) page_size);
+		skew = d->mapoffset - offset;
+
+		m->map_size = d->maxsize + skew;
+		m->map = mmap(NULL, m->map_size, PROT_READ,
+			      MAP_SHARED | (state->populate ? MAP_POPULATE : 0),
+			      d->fd, offset);
+		if (m->map == MAP_FAILED) {
+			int res = -errno;
+			spa_log_error(state->log, "null-sink %p: can't map buffer %u fd:%" PRIi64 ": %m",
+				      state, id, d->fd);
+			spa_zero(*m);
+			return res;
+		}
+		m->data = SPA_PTROFF(m->map, skew, void);
+		return 0;
+
+	default:
+		spa_log_error(state->log, "null-sink %p: buffer %u has unsupported data type %s",
+			      state, id, spa_debug_type_find_name(spa_type_data_type, d->type));
+		return -ENOTSUP;
+	}
+}
+
+/**
+ * @brief Map the kept buffers again after a Suspend
+ *
+ * Only entries without readable memory are mapped, buffers that can't be
+ * are only counted by chunk size. The table reaches the data loop with
+ * the next config swap.
+ */
+static void remap_buffers(struct null_state *state)
+{
+	uint32_t i;
+
+	for (i = 0; i < state->n_buffers; i++) {
+		if (state->buffers[i] != NULL && state->mems[i].data == NULL)
+			map_buffer(state, i, state->buffers[i]);
+	}
+}
+
 /**
  * @brief Use buffers for specific port
  *
  * This function is called when the graph assigns buffers to a port.
- * The null sink doesn't need to store buffer references since it
- * just drops data immediately.
+ * The null sink keeps the buffer table so impl_node_process() can map
+ * the buffer_id from the io area to a buffer, and the readable memory
+ * of the first data plane for the kernels that parse payloads.
  *
  * @param object Pointer to spa_node interface (cast to null_state)
  * @param direction Port direction (input/output)
@@ -830,25 +1586,64 @@ static int impl_node_set_port_param(void *object,
  * @param n_buffers Number of buffers in array
  *
  * @return 0 on success
+ * @return -ENOSPC if more than MAX_BUFFERS buffers are passed
  */
-static int impl_node_use_buffers(void *object,
-                                enum spa_direction direction, uint32_t port_id,
-                                uint32_t flags,
-                                struct spa_buffer **buffers, uint32_t n_buffers)
+static int node_use_buffers(void *object,
+                            enum spa_direction direction, uint32_t port_id,
+                            uint32_t flags,
+                            struct spa_buffer **buffers, uint32_t n_buffers)
 {
 	struct null_state *state = object;
+	uint32_t i;
+	int res = 0;
 
 	spa_return_val_if_fail(state != NULL, -EINVAL);
 
 	if (direction != SPA_DIRECTION_INPUT || port_id != 0)
 		return -EINVAL;
 
-	/* Null sink doesn't need to store buffers - just accept them */
+	if (n_buffers > MAX_BUFFERS)
+		return -ENOSPC;
+
+	/* Release the mappings of the previous buffer set */
+	clear_buffers(state);
+
+	/* Keep the buffer table - buffers are dropped, never copied */
+	for (i = 0; i < n_buffers; i++) {
+		if ((res = map_buffer(state, i, buffers[i])) < 0)
+			break;
+		state->buffers[i] = buffers[i];
+		state->n_buffers = i + 1;
+	}
+	if (res < 0) {
+		clear_buffers(state);
+		return res;
+	}
+	if (state->mlock && state->started)
+		null_memory_lock_buffers(state);
+
+	/* The kernels only see the new set from here on */
+	null_process_set_buffers(state);
+
 	spa_log_debug(state->log, "null-sink %p: using %d buffers", state, n_buffers);
 
 	return 0;
 }
 
+static int impl_node_use_buffers(void *object,
+                                enum spa_direction direction, uint32_t port_id,
+                                uint32_t flags,
+                                struct spa_buffer **buffers, uint32_t n_buffers)
+{
+	int res;
+
+	NULL_PROBE(use_buffers_entry, object, port_id, flags, n_buffers);
+	res = node_use_buffers(object, direction, port_id, flags, buffers, n_buffers);
+	NULL_PROBE(use_buffers_exit, object, res);
+
+	return res;
+}
+
 /**
  * @brief Set I/O area for specific port
  *
@@ -900,7 +1695,7 @@ static const struct spa_node_methods impl_node = {
 	SPA_VERSION_NODE_METHODS,
 	.add_listener = impl_node_add_listener,
 	.set_callbacks = NULL,  /* Not needed for sink nodes */
-	.sync = NULL,           /* Synchronous operation */
+	.sync = impl_node_sync,
 	.enum_params = impl_node_enum_params,
 	.set_param = impl_node_set_param,
 	.set_io = impl_node_set_io,
@@ -985,8 +1780,16 @@ static int impl_init(const struct spa_handle_factory *factory,
 	struct null_state *state = (struct null_state *) handle;
 	struct spa_log *log = NULL;
 	struct spa_system *system = NULL;
-	struct spa_loop *loop = NULL;
+	struct spa_loop *loop = NULL, *main_loop = NULL;
+	const char *group = NULL, *node_name = NULL;
+	bool shm = false, preset = false;
+	struct spa_process_latency_info latency = SPA_PROCESS_LATENCY_INFO_INIT();
+	struct spa_audio_info_raw raw = SPA_AUDIO_INFO_RAW_INIT(
+			.format = SPA_AUDIO_FORMAT_F32P,
+			.channels = 2,
+			.rate = 48000);
 	uint32_t i;
+	int res;
 
 	spa_return_val_if_fail(factory != NULL, -EINVAL);
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
@@ -1003,6 +1806,9 @@ static int impl_init(const struct spa_handle_factory *factory,
 		case SPA_TYPE_INTERFACE_DataLoop:
 			loop = support[i].data;
 			break;
+		case SPA_TYPE_INTERFACE_Loop:
+			main_loop = support[i].data;
+			break;
 		}
 	}
 
@@ -1011,7 +1817,147 @@ static int impl_init(const struct spa_handle_factory *factory,
 	}
 
 	/* Initialize state */
-	return null_state_init(state, log, system, loop);
+	if ((res = null_state_init(state, log, system, loop)) < 0)
+		return res;
+
+	state->main_loop = main_loop;
+
+	/* Handle methods - set after init since it clears the whole state */
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	/* The factory decides which media the instance negotiates */
+	if (factory == &spa_null_video_sink_factory)
+		state->kind = NULL_SINK_VIDEO;
+	else if (factory == &spa_null_control_sink_factory)
+		state->kind = NULL_SINK_CONTROL;
+
+	/* Apply factory properties */
+	for (i = 0; info && i < info->n_items; i++) {
+		const char *k = info->items[i].key;
+		const char *s = info->items[i].value;
+
+		if (spa_streq(k, NULL_KEY_NODE_ASYNC))
+			state->async = spa_atob(s);
+		else if (spa_streq(k, NULL_KEY_STATS))
+			state->stats = spa_atob(s);
+		else if (spa_streq(k, NULL_KEY_GROUP) && s != NULL && *s != '\0')
+			group = s;
+		else if (spa_streq(k, NULL_KEY_MMAP_POPULATE))
+			state->populate = spa_atob(s);
+		else if (spa_streq(k, NULL_KEY_MLOCK))
+			state->mlock = spa_atob(s);
+		else if (spa_streq(k, NULL_KEY_PERF))
+			state->perf_enabled = spa_atob(s);
+		else if (spa_streq(k, NULL_KEY_TIMING))
+			state->timing_enabled = spa_atob(s);
+		else if (spa_streq(k, NULL_KEY_SHM))
+			shm = spa_atob(s);
+		else if (spa_streq(k, NULL_KEY_LATENCY_AUTO))
+			state->latency_auto = spa_atob(s);
+		else if (spa_streq(k, SPA_KEY_NODE_NAME))
+			node_name = s;
+		else if (spa_streq(k, SPA_KEY_AUDIO_FORMAT)) {
+			raw.format = spa_type_audio_format_from_short_name(s);
+			preset = true;
+		} else if (spa_streq(k, SPA_KEY_AUDIO_RATE) ||
+			   spa_streq(k, SPA_KEY_AUDIO_CHANNELS)) {
+			uint32_t *val = spa_streq(k, SPA_KEY_AUDIO_RATE) ? &raw.rate : &raw.channels;
+
+			/* A typo must not silently run the sink at the default */
+			if (!spa_atou32(s, val, 0)) {
+				spa_log_error(log, "null-sink %p: invalid %s '%s'",
+					      state, k, s ? s : "");
+				null_state_cleanup(state);
+				return -EINVAL;
+			}
+			preset = true;
+		} else if (spa_streq(k, NULL_KEY_NODE_LATENCY)) {
+			uint32_t num, denom;
+
+			/* Like audio.rate: a typo must not publish a bogus latency */
+			if (s == NULL || sscanf(s, "%u/%u", &num, &denom) != 2 || denom == 0) {
+				spa_log_error(log, "null-sink %p: invalid %s '%s'",
+					      state, k, s ? s : "");
+				null_state_cleanup(state);
+				return -EINVAL;
+			}
+			state->latency = SPA_FRACTION(num, denom);
+		} else if (spa_streq(k, NULL_KEY_QUANTUM_LIMIT))
+			state->quantum_limit = s ? strtoull(s, NULL, 0) : 0;
+		else if (spa_streq(k, NULL_KEY_LATENCY_QUANTUM))
+			spa_atof(s, &latency.quantum);
+		else if (spa_streq(k, NULL_KEY_LATENCY_RATE))
+			spa_atou32(s, &latency.rate, 0);
+		else if (spa_streq(k, NULL_KEY_LATENCY_NS))
+			spa_atou64(s, &latency.ns, 0);
+	}
+
+	/*
+	 * ASYNC SCHEDULING:
+	 * ================
+	 * An async node is not waited on by the graph: its input holds the
+	 * data of the previous cycle, so consumption overlaps with upstream
+	 * processing of the next cycle.
+	 */
+	if (state->async)
+		state->info.flags |= SPA_NODE_FLAG_ASYNC;
+
+	/*
+	 * GROUPED PROCESSING:
+	 * ==================
+	 * Register with the shared aggregator for this group key.
+	 */
+	if (group != NULL && (res = null_group_join(state, group)) < 0) {
+		spa_log_error(log, "null-sink %p: can't join group '%s': %s",
+			      state, group, spa_strerror(res));
+		return res;
+	}
+
+	/* Emulated device latency, reported in ProcessLatency and Latency */
+	null_latency_set_process(state, &latency);
+
+	/* Requested latency, changeable at runtime through Props */
+	null_props_update_info(state);
+
+	/*
+	 * PRESET FORMAT:
+	 * =============
+	 * audio.format/rate/channels fix the format up front: the sink is
+	 * configured and can be started without a set_param round-trip,
+	 * and only this format is enumerated and accepted. Missing keys
+	 * default to F32P, 2 channels, 48000 Hz. The properties carry no
+	 * channel map, so the preset is unpositioned.
+	 */
+	if (preset && state->kind == NULL_SINK_AUDIO) {
+		raw.flags |= SPA_AUDIO_FLAG_UNPOSITIONED;
+		if ((res = apply_raw_format(state, &raw)) < 0) {
+			null_state_cleanup(state);
+			return res;
+		}
+		state->preset_format = raw;
+		state->preset = true;
+		state->port_params[NULL_PORT_PARAM_Format].flags = SPA_PARAM_INFO_READWRITE;
+		state->port_params[NULL_PORT_PARAM_Buffers].flags = SPA_PARAM_INFO_READ;
+	}
+
+	/*
+	 * SHARED-MEMORY STATS:
+	 * ===================
+	 * A segment that can't be created only disables publishing.
+	 */
+	if (shm)
+		null_shm_open(state, node_name);
+
+	null_process_select(state);
+
+	spa_log_info(log, "null-sink %p: %s async:%d group:%s stats:%d mlock:%d preset:%d "
+		     "latency:%u/%u%s quantum-limit:%" PRIu64, state,
+		     factory->name, state->async, group ? group : "none", state->stats,
+		     state->mlock, state->preset, state->latency.num, state->latency.denom,
+		     state->latency_auto ? " (auto)" : "", state->quantum_limit);
+
+	return 0;
 }
 
 static const struct spa_interface_info impl_interfaces[] = {
@@ -1051,6 +1997,36 @@ const struct spa_handle_factory spa_null_sink_factory = {
 	.enum_interface_info = impl_enum_interface_info,
 };
 
+/**
+ * @brief Null video sink factory definition
+ *
+ * Same node as the audio null sink, negotiating raw and DMA-BUF video
+ * formats instead (see null-video.c). Frames are counted and dropped
+ * without mapping their memory.
+ */
+const struct spa_handle_factory spa_null_video_sink_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	.name = SPA_NAME_API_NULL_VIDEO_SINK,
+	.get_size = impl_get_size,
+	.init = impl_init,
+	.enum_interface_info = impl_enum_interface_info,
+};
+
+/**
+ * @brief Null control sink factory definition
+ *
+ * Same node as the audio null sink, negotiating application/control.
+ * Event sequences are walked in place to count events by type and
+ * measure their timing within the quantum (see null-control.c).
+ */
+const struct spa_handle_factory spa_null_control_sink_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	.name = SPA_NAME_API_NULL_CONTROL_SINK,
+	.get_size = impl_get_size,
+	.init = impl_init,
+	.enum_interface_info = impl_enum_interface_info,
+};
+
 /*
  * STATE MANAGEMENT IMPLEMENTATION:
  * ===============================
@@ -1063,6 +2039,8 @@ int null_state_init(struct null_state *state,
                    struct spa_system *system,
                    struct spa_loop *loop)
 {
+	uint32_t i;
+
 	spa_return_val_if_fail(state != NULL, -EINVAL);
 	spa_return_val_if_fail(log != NULL, -EINVAL);
 	spa_return_val_if_fail(system != NULL, -EINVAL);
@@ -1084,19 +2062,57 @@ int null_state_init(struct null_state *state,
 	/* Initialize hook list for events */
 	spa_hook_list_init(&state->hooks);
 
+	/* No emulated device latency until configured */
+	null_latency_init(state);
+
+	/* Diagnostics ring, drained on the main loop */
+	spa_ringbuffer_init(&state->rtlog.ring);
+
+	/* Hardware counters are opened on Start when enabled */
+	for (i = 0; i < NULL_PERF_COUNTERS; i++)
+		state->perf.counters[i].fd = -1;
+
 	/* Initialize node info */
 	state->info_all = SPA_NODE_CHANGE_MASK_FLAGS |
+			  SPA_NODE_CHANGE_MASK_PROPS |
 			  SPA_NODE_CHANGE_MASK_PARAMS;
 	state->info = SPA_NODE_INFO_INIT();
 	state->info.max_input_ports = 1;
 	state->info.max_output_ports = 0;
 	state->info.flags = SPA_NODE_FLAG_RT;
+	state->params[NULL_NODE_PARAM_PropInfo] =
+		SPA_PARAM_INFO(SPA_PARAM_PropInfo, SPA_PARAM_INFO_READ);
+	state->params[NULL_NODE_PARAM_Props] =
+		SPA_PARAM_INFO(SPA_PARAM_Props, SPA_PARAM_INFO_READWRITE);
+	state->params[NULL_NODE_PARAM_ProcessLatency] =
+		SPA_PARAM_INFO(SPA_PARAM_ProcessLatency, SPA_PARAM_INFO_READWRITE);
+	state->info.params = state->params;
+	state->info.n_params = NULL_N_NODE_PARAMS;
 
 	/* Initialize port info */
 	state->port_info_all = SPA_PORT_CHANGE_MASK_FLAGS |
 			       SPA_PORT_CHANGE_MASK_PARAMS;
 	state->port_info = SPA_PORT_INFO_INIT();
 	state->port_info.flags = SPA_PORT_FLAG_NO_REF;
+	state->port_params[NULL_PORT_PARAM_EnumFormat] =
+		SPA_PARAM_INFO(SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
+	state->port_params[NULL_PORT_PARAM_Format] =
+		SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+	state->port_params[NULL_PORT_PARAM_Buffers] =
+		SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	state->port_params[NULL_PORT_PARAM_Latency] =
+		SPA_PARAM_INFO(SPA_PARAM_Latency, SPA_PARAM_INFO_READWRITE);
+	state->port_params[NULL_PORT_PARAM_ProcessLatency] =
+		SPA_PARAM_INFO(SPA_PARAM_ProcessLatency, SPA_PARAM_INFO_READWRITE);
+	state->port_info.params = state->port_params;
+	state->port_info.n_params = NULL_N_PORT_PARAMS;
+
+	/* Statistics on by default, idle until started with a format */
+	state->stats = true;
+	state->timing_enabled = true;
+	null_timing_reset(state);
+	state->offset_min = UINT32_MAX;
+	null_process_select(state);
 
 	spa_log_info(log, "null-sink %p: initialized", state);
 
@@ -1108,6 +2124,19 @@ void null_state_cleanup(struct null_state *state)
 	if (state == NULL)
 		return;
 
+	/* Leave the shared aggregator before the state goes away */
+	null_group_leave(state);
+
+	/* No drain may run on the main loop after this */
+	null_rtlog_flush(state);
+
+	null_perf_close(state);
+	null_shm_close(state);
+
+	/* Unmap the buffer memory mapped in use_buffers */
+	clear_buffers(state);
+	null_memory_unlock(state);
+
 	/* Remove all event hooks */
 	spa_hook_list_clean(&state->hooks);
 
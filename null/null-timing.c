@@ -0,0 +1,129 @@
+/* SPA Null Sink Graph Cycle Timing */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-timing.c
+ * @brief SPA Null Sink - Scheduling latency and cycle jitter of the graph
+ *
+ * The graph driver stamps every cycle with its wakeup time in
+ * spa_io_clock.nsec. A sink runs at the end of the cycle, so comparing
+ * that stamp with the time the sink's process() runs makes every null
+ * sink a free probe of graph scheduling health:
+ *
+ *   latency   now - clock.nsec
+ *             how long after the driver wakeup this sink ran
+ *
+ *   jitter    |(clock.nsec - previous clock.nsec) - previous period|
+ *             how far the driver's wakeups deviate from the quantum,
+ *             where period = duration * rate.num / rate.denom seconds
+ *
+ * Both are kept as count/sum/min/max and a histogram with power-of-two
+ * microsecond buckets: [0,1) [1,2) [2,4) ... [8192,16384) and above.
+ *
+ * The clock comes from SPA_IO_Clock when set, else from the clock
+ * embedded in SPA_IO_Position. Without either there is nothing to
+ * compare against and null_process_select() leaves the kernel as is.
+ * Enabled by default, null.timing=false turns it off.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "null.h"
+
+static inline uint32_t bucket(uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+
+	if (us == 0)
+		return 0;
+	return SPA_MIN(64u - __builtin_clzll(us), NULL_TIMING_BUCKETS - 1u);
+}
+
+static inline void add_sample(struct null_timing_stat *s, uint64_t ns)
+{
+	s->count++;
+	s->sum += ns;
+	s->min = SPA_MIN(s->min, ns);
+	s->max = SPA_MAX(s->max, ns);
+	s->hist[bucket(ns)]++;
+}
+
+static inline struct spa_io_clock *get_clock(struct null_state *state)
+{
+	if (state->rt.clock != NULL)
+		return state->rt.clock;
+	return state->rt.position ? &state->rt.position->clock : NULL;
+}
+
+int null_timing_process(struct null_state *state)
+{
+	struct null_timing *t = &state->timing;
+	struct spa_io_clock *clock = get_clock(state);
+	uint64_t now, nsec, delta, expected;
+
+	if (spa_likely(clock != NULL) && (nsec = clock->nsec) != 0 && nsec != t->last_nsec) {
+		now = t->now = null_get_time(state);
+		if (spa_likely(now >= nsec))
+			add_sample(&t->latency, now - nsec);
+
+		/* A new driver starts a new series */
+		if (t->last_nsec != 0 && clock->id == t->last_id && nsec > t->last_nsec) {
+			delta = nsec - t->last_nsec;
+			expected = t->last_period;
+			if (expected != 0)
+				add_sample(&t->jitter, delta > expected ? delta - expected : expected - delta);
+		}
+
+		t->last_nsec = nsec;
+		t->last_id = clock->id;
+		t->last_period = clock->rate.denom ?
+			clock->duration * SPA_NSEC_PER_SEC * clock->rate.num / clock->rate.denom : 0;
+
+		if (state->rt.latency_auto && now >= nsec)
+			null_props_auto_sample(state, clock, now - nsec, t->last_period);
+	}
+
+	return state->rt.timing_kernel(state);
+}
+
+void null_timing_reset(struct null_state *state)
+{
+	struct null_timing *t = &state->timing;
+
+	spa_zero(t->latency);
+	spa_zero(t->jitter);
+	t->latency.min = t->jitter.min = UINT64_MAX;
+	t->last_nsec = 0;
+	t->last_period = 0;
+}
+
+static void log_stat(struct null_state *state, const char *name,
+                     const struct null_timing_stat *s)
+{
+	char hist[NULL_TIMING_BUCKETS * 12];
+	uint32_t i;
+	int len = 0;
+
+	if (s->count == 0)
+		return;
+
+	for (i = 0; i < NULL_TIMING_BUCKETS; i++) {
+		int r = snprintf(hist + len, sizeof(hist) - len, "%s%u",
+				 i ? " " : "", s->hist[i]);
+		if (r < 0 || r >= (int) sizeof(hist) - len)
+			break;
+		len += r;
+	}
+
+	spa_log_info(state->log, "null-sink %p: %s min:%" PRIu64 " avg:%" PRIu64
+		     " max:%" PRIu64 " ns over %" PRIu64 " cycles, histogram (log2 us): %s",
+		     state, name, s->min, s->sum / s->count, s->max, s->count, hist);
+}
+
+void null_timing_log(struct null_state *state)
+{
+	log_stat(state, "scheduling latency", &state->timing.latency);
+	log_stat(state, "cycle jitter", &state->timing.jitter);
+}
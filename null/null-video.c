@@ -0,0 +1,180 @@
+/* SPA Null Video Sink Format Handling */
+/* SPDX-FileCopyrightText: Copyright © 2024 */
+/* SPDX-License-Identifier: MIT */
+
+/**
+ * @file null-video.c
+ * @brief SPA Null Sink - Raw and DMA-BUF video format negotiation
+ *
+ * The api.null.video-sink factory creates the same null sink node as the
+ * audio factory, but negotiates video/raw formats. It is meant as a zero
+ * cost terminal for screen-capture and camera pipelines, so it never maps
+ * the frames it consumes: a DMA-BUF frame is counted from its chunk sizes
+ * and dropped without ever touching the memory.
+ *
+ * VIDEO FORMAT NEGOTIATION:
+ * ========================
+ * Two formats are enumerated, in order of preference:
+ *
+ * 1. DMA-BUF: video/raw with a mandatory modifier property. The modifiers
+ *    LINEAR and INVALID (implicit modifier) are offered; the producer
+ *    picks one it can allocate.
+ * 2. Shared memory: video/raw without modifier, for MemFd/MemPtr buffers.
+ *
+ * Both accept any common packed RGB or YUV format, any size and any
+ * framerate, since nothing is ever rendered.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+
+#include <spa/debug/types.h>
+#include <spa/param/video/format-utils.h>
+#include <spa/param/video/type-info.h>
+#include <spa/pod/builder.h>
+
+#include "null.h"
+
+/*
+ * DRM MODIFIERS:
+ * =============
+ * Values from drm_fourcc.h, spelled out to avoid a libdrm dependency.
+ */
+#define NULL_DRM_FORMAT_MOD_LINEAR	0ULL
+#define NULL_DRM_FORMAT_MOD_INVALID	((1ULL << 56) - 1)
+
+/** Video formats offered in both enumerated formats, first is default */
+static const uint32_t video_formats[] = {
+	SPA_VIDEO_FORMAT_BGRx,
+	SPA_VIDEO_FORMAT_RGBx,
+	SPA_VIDEO_FORMAT_BGRA,
+	SPA_VIDEO_FORMAT_RGBA,
+	SPA_VIDEO_FORMAT_xRGB,
+	SPA_VIDEO_FORMAT_ARGB,
+	SPA_VIDEO_FORMAT_NV12,
+	SPA_VIDEO_FORMAT_I420,
+	SPA_VIDEO_FORMAT_YUY2,
+};
+
+static struct spa_pod *build_video_format(struct spa_pod_builder *b, uint32_t id,
+                                          bool dmabuf)
+{
+	struct spa_pod_frame f[2];
+	uint32_t i;
+
+	spa_pod_builder_push_object(b, &f[0], SPA_TYPE_OBJECT_Format, id);
+	spa_pod_builder_add(b,
+		SPA_FORMAT_mediaType,    SPA_POD_Id(SPA_MEDIA_TYPE_video),
+		SPA_FORMAT_mediaSubtype, SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
+		0);
+
+	/* Format choice: default followed by all alternatives */
+	spa_pod_builder_prop(b, SPA_FORMAT_VIDEO_format, 0);
+	spa_pod_builder_push_choice(b, &f[1], SPA_CHOICE_Enum, 0);
+	spa_pod_builder_id(b, video_formats[0]);
+	for (i = 0; i < SPA_N_ELEMENTS(video_formats); i++)
+		spa_pod_builder_id(b, video_formats[i]);
+	spa_pod_builder_pop(b, &f[1]);
+
+	/*
+	 * DMA-BUF MODIFIERS:
+	 * =================
+	 * The modifier property is mandatory so the format only matches
+	 * producers that allocate DMA-BUFs, and must not be fixated by the
+	 * graph since the producer decides which modifier it can use.
+	 */
+	if (dmabuf) {
+		spa_pod_builder_prop(b, SPA_FORMAT_VIDEO_modifier,
+				SPA_POD_PROP_FLAG_MANDATORY | SPA_POD_PROP_FLAG_DONT_FIXATE);
+		spa_pod_builder_push_choice(b, &f[1], SPA_CHOICE_Enum, 0);
+		spa_pod_builder_long(b, NULL_DRM_FORMAT_MOD_INVALID);
+		spa_pod_builder_long(b, NULL_DRM_FORMAT_MOD_INVALID);
+		spa_pod_builder_long(b, NULL_DRM_FORMAT_MOD_LINEAR);
+		spa_pod_builder_pop(b, &f[1]);
+	}
+
+	spa_pod_builder_add(b,
+		SPA_FORMAT_VIDEO_size,      SPA_POD_CHOICE_RANGE_Rectangle(
+						&SPA_RECTANGLE(1920, 1080),
+						&SPA_RECTANGLE(1, 1),
+						&SPA_RECTANGLE(16384, 16384)),
+		SPA_FORMAT_VIDEO_framerate, SPA_POD_CHOICE_RANGE_Fraction(
+						&SPA_FRACTION(30, 1),
+						&SPA_FRACTION(0, 1),
+						&SPA_FRACTION(1000, 1)),
+		0);
+
+	return spa_pod_builder_pop(b, &f[0]);
+}
+
+int null_video_enum_format(struct null_state *state, uint32_t id, uint32_t index,
+                           struct spa_pod_builder *b, struct spa_pod **param)
+{
+	switch (index) {
+	case 0:
+		*param = build_video_format(b, id, true);
+		return 1;
+	case 1:
+		*param = build_video_format(b, id, false);
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+int null_video_build_format(struct null_state *state, uint32_t id,
+                            struct spa_pod_builder *b, struct spa_pod **param)
+{
+	*param = spa_format_video_raw_build(b, id, &state->video_format.info.raw);
+	return *param != NULL;
+}
+
+int null_video_parse_format(struct null_state *state, const struct spa_pod *param,
+                            struct spa_video_info *info)
+{
+	int res;
+
+	spa_zero(*info);
+
+	if ((res = spa_format_parse(param, &info->media_type, &info->media_subtype)) < 0)
+		return res;
+
+	if (info->media_type != SPA_MEDIA_TYPE_video ||
+	    info->media_subtype != SPA_MEDIA_SUBTYPE_raw) {
+		spa_log_error(state->log, "null-sink %p: unsupported media type %d/%d",
+			     state, info->media_type, info->media_subtype);
+		return -EINVAL;
+	}
+
+	if ((res = spa_format_video_raw_parse(param, &info->info.raw)) < 0) {
+		spa_log_error(state->log, "null-sink %p: failed to parse video format: %s",
+			     state, spa_strerror(res));
+		return res;
+	}
+
+	if (info->info.raw.size.width == 0 || info->info.raw.size.height == 0) {
+		spa_log_error(state->log, "null-sink %p: invalid video size %ux%u",
+			     state, info->info.raw.size.width, info->info.raw.size.height);
+		return -EINVAL;
+	}
+
+	spa_log_info(state->log, "null-sink %p: video format %s %ux%u@%u/%u modifier:%s0x%" PRIx64,
+		    state,
+		    spa_debug_type_find_name(spa_type_video_format, info->info.raw.format),
+		    info->info.raw.size.width, info->info.raw.size.height,
+		    info->info.raw.framerate.num, info->info.raw.framerate.denom,
+		    SPA_FLAG_IS_SET(info->info.raw.flags, SPA_VIDEO_FLAG_MODIFIER) ? "" : "none ",
+		    info->info.raw.modifier);
+
+	return 0;
+}
+
+uint64_t null_video_frame_interval(const struct spa_video_info *info)
+{
+	const struct spa_fraction *rate = &info->info.raw.framerate;
+
+	if (rate->num == 0 || rate->denom == 0)
+		return 0;
+
+	return SPA_NSEC_PER_SEC * rate->denom / rate->num;
+}
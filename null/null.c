@@ -51,6 +51,9 @@
 
 /* External factory declarations for null components */
 extern const struct spa_handle_factory spa_null_sink_factory;
+extern const struct spa_handle_factory spa_null_video_sink_factory;
+extern const struct spa_handle_factory spa_null_control_sink_factory;
+extern const struct spa_handle_factory spa_null_loopback_factory;
 
 /**
  * @brief Null plugin log topic definition
@@ -111,7 +114,19 @@ SPA_LOG_TOPIC_ENUM_DEFINE_REGISTERED;
  * // Call 0: index=0 -> returns spa_null_sink_factory, index becomes 1
  * spa_handle_factory_enum(&factory, &index);  // returns 1
  *
- * // Call 1: index=1 -> no more factories, returns 0
+ * // Call 1: index=1 -> returns spa_null_video_sink_factory, index becomes 2
+ * spa_handle_factory_enum(&factory, &index);  // returns 1
+ *
+ * // Call 2: index=2 -> returns spa_null_control_sink_factory, index becomes 3
+ * spa_handle_factory_enum(&factory, &index);  // returns 1
+ *
+ * // Call 3: index=3 -> returns spa_null_loopback_factory, index becomes 4
+ * spa_handle_factory_enum(&factory, &index);  // returns 1
+ *
+ * // Call 4: index=4 -> returns spa_null_mix_sink_factory, index becomes 5
+ * spa_handle_factory_enum(&factory, &index);  // returns 1
+ *
+ * // Call 5: index=5 -> no more factories, returns 0
  * spa_handle_factory_enum(&factory, &index);  // returns 0, enumeration ends
  * @endcode
  *
@@ -146,8 +161,11 @@ int spa_handle_factory_enum(const struct spa_handle_factory **factory, uint32_t
 	 * Switch on index to return appropriate factory. The order matters as it
 	 * determines the registration order in PipeWire core.
 	 *
-	 * For this educational null plugin, we only provide one factory:
+	 * For this educational null plugin, we provide sink factories:
 	 * - Index 0: spa_null_sink_factory (creates null audio sink nodes)
+	 * - Index 1: spa_null_video_sink_factory (creates null video sink nodes)
+	 * - Index 2: spa_null_control_sink_factory (creates null MIDI/control sinks)
+	 * - Index 3: spa_null_loopback_factory (null sink with a delayed output)
 	 *
 	 * More complex plugins would have multiple factories:
 	 * - Index 0: Source factory (input nodes)
@@ -170,6 +188,46 @@ int spa_handle_factory_enum(const struct spa_handle_factory **factory, uint32_t
 		 */
 		*factory = &spa_null_sink_factory;
 		break;
+	case 1:
+		/*
+		 * NULL VIDEO SINK FACTORY:
+		 * ========================
+		 * Creates spa_node objects that accept raw or DMA-BUF video
+		 * frames and drop them without mapping, as a zero cost
+		 * terminal for capture and encoder benchmarks.
+		 */
+		*factory = &spa_null_video_sink_factory;
+		break;
+	case 2:
+		/*
+		 * NULL CONTROL SINK FACTORY:
+		 * ==========================
+		 * Creates spa_node objects that accept application/control
+		 * streams (MIDI, OSC, properties) and report event counts
+		 * and timing skew before dropping them.
+		 */
+		*factory = &spa_null_control_sink_factory;
+		break;
+	case 3:
+		/*
+		 * NULL LOOPBACK FACTORY:
+		 * =====================
+		 * Creates spa_node objects that consume audio like the null
+		 * sink and republish it on an output port one quantum later,
+		 * as a monitor point and delay line for graph benchmarks.
+		 */
+		*factory = &spa_null_loopback_factory;
+		break;
+	case 4:
+		/*
+		 * NULL MIX SINK FACTORY:
+		 * =====================
+		 * Creates spa_node objects with dynamic audio inputs that are
+		 * summed into one accumulator every cycle and then dropped or
+		 * metered, a terminal for conference-style graphs.
+		 */
+		*factory = &spa_null_mix_sink_factory;
+		break;
 	default:
 		/*
 		 * END OF ENUMERATION:
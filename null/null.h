@@ -45,12 +45,14 @@ extern "C" {
 
 #include <stdint.h>
 #include <stddef.h>
+#include <time.h>
 
 /* SPA Core Headers */
 #include <spa/utils/defs.h>
 #include <spa/utils/dict.h>
 #include <spa/utils/hook.h>
 #include <spa/utils/result.h>
+#include <spa/utils/ringbuffer.h>
 
 /* SPA Node Interface */
 #include <spa/node/node.h>
@@ -59,8 +61,11 @@ extern "C" {
 
 /* SPA Parameter System */
 #include <spa/param/param.h>
+#include <spa/param/latency-utils.h>
 #include <spa/param/audio/format.h>
 #include <spa/param/audio/raw.h>
+#include <spa/param/video/format.h>
+#include <spa/param/video/raw.h>
 
 /* SPA Support Interfaces */
 #include <spa/support/log.h>
@@ -89,9 +94,99 @@ extern "C" {
 /** Plugin name for null sink factory */
 #define SPA_NAME_API_NULL_SINK    "api.null.sink"
 
+/** Plugin name for null video sink factory */
+#define SPA_NAME_API_NULL_VIDEO_SINK "api.null.video-sink"
+
+/** Plugin name for null control (MIDI) sink factory */
+#define SPA_NAME_API_NULL_CONTROL_SINK "api.null.control-sink"
+
+/** Plugin name for null loopback (delayed monitor) factory */
+#define SPA_NAME_API_NULL_LOOPBACK "api.null.loopback"
+
+/** Plugin name for null mix sink (multi-input mixdown) factory */
+#define SPA_NAME_API_NULL_MIX_SINK "api.null.mix-sink"
+
+/** Number of SPA_CONTROL_* types counted separately, higher ones share the last */
+#define NULL_CONTROL_TYPES 8
+
 /** Plugin library name */
 #define SPA_NAME_LIB_NULL         "null"
 
+/*
+ * FACTORY PROPERTY KEYS:
+ * ======================
+ * Keys read from the spa_dict passed to impl_init(). They use the same
+ * names as the PipeWire node properties so they can be set directly from
+ * pw-cli or a session manager rule.
+ */
+
+/** Schedule the null sink as an async node (SPA_NODE_FLAG_ASYNC) */
+#define NULL_KEY_NODE_ASYNC       "node.async"
+
+/** Register with the shared aggregator of this group key */
+#define NULL_KEY_GROUP            "null.group"
+
+/** Count dropped frames and buffers (default true) */
+#define NULL_KEY_STATS            "null.stats"
+
+/** Prefault MemFd buffer mappings with MAP_POPULATE (default false) */
+#define NULL_KEY_MMAP_POPULATE    "null.mmap-populate"
+
+/** Lock and prefault all memory touched by process() on Start (default false) */
+#define NULL_KEY_MLOCK            "null.mlock"
+
+/** Measure process() with perf_event hardware counters (default false) */
+#define NULL_KEY_PERF             "null.perf"
+
+/** Measure graph scheduling latency and cycle jitter (default true) */
+#define NULL_KEY_TIMING           "null.timing"
+
+/** Requested graph latency as quantum/rate, e.g. "256/48000" */
+#define NULL_KEY_NODE_LATENCY     "node.latency"
+
+/** Largest quantum the sink has to handle, in frames */
+#define NULL_KEY_QUANTUM_LIMIT    "clock.quantum-limit"
+
+/** Emulated device latency in quanta, frames and nanoseconds (default 0) */
+#define NULL_KEY_LATENCY_QUANTUM  "latency.internal.quantum"
+#define NULL_KEY_LATENCY_RATE     "latency.internal.rate"
+#define NULL_KEY_LATENCY_NS       "latency.internal.ns"
+
+/** Publish counters in a POSIX shm segment named after node.name (default false) */
+#define NULL_KEY_SHM              "null.shm"
+
+/** Runtime Props (SPA_PROP_params): requested latency and auto mode */
+#define NULL_KEY_LATENCY          "null.latency"
+#define NULL_KEY_LATENCY_AUTO     "null.latency-auto"
+
+/** Mix sink: meter the mix (default true), also a runtime Prop */
+#define NULL_KEY_MIX_METER        "null.mix.meter"
+
+/** Mix sink: use the SIMD kernels the CPU supports (default true) */
+#define NULL_KEY_MIX_SIMD         "null.mix.simd"
+
+/** Mix sink: read-only Props with the peak and RMS of the last cycle */
+#define NULL_KEY_MIX_PEAK         "null.mix.peak"
+#define NULL_KEY_MIX_RMS          "null.mix.rms"
+
+/** Index of each node param in null_state.params */
+enum null_node_param {
+	NULL_NODE_PARAM_PropInfo,
+	NULL_NODE_PARAM_Props,
+	NULL_NODE_PARAM_ProcessLatency,
+	NULL_N_NODE_PARAMS,
+};
+
+/** Index of each input port param in null_state.port_params */
+enum null_port_param {
+	NULL_PORT_PARAM_EnumFormat,
+	NULL_PORT_PARAM_Format,
+	NULL_PORT_PARAM_Buffers,
+	NULL_PORT_PARAM_Latency,
+	NULL_PORT_PARAM_ProcessLatency,
+	NULL_N_PORT_PARAMS,
+};
+
 /*
  * LOGGING SUPPORT:
  * ===============
@@ -105,6 +200,194 @@ extern struct spa_log_topic null_log_topic;
 /** Convenience macro for logging with null plugin topic */
 #define spa_log_topic_default &null_log_topic
 
+/** Shared process aggregator for grouped null sinks (null-group.c) */
+struct null_group;
+
+struct null_state;
+
+/** Stats segment published in POSIX shm (null-shm.h) */
+struct null_shm_segment;
+
+/**
+ * @brief Media handled by a null sink instance, set by its factory
+ */
+enum null_sink_kind {
+	NULL_SINK_AUDIO,              /**< audio/raw (api.null.sink) */
+	NULL_SINK_VIDEO,              /**< video/raw (api.null.video-sink) */
+	NULL_SINK_CONTROL,            /**< application/control (api.null.control-sink) */
+};
+
+/**
+ * @brief Specialized process kernel (null-process.c)
+ *
+ * Selected by null_process_select() whenever the node state, format or
+ * features change, and called from impl_node_process() on every cycle.
+ */
+typedef int (*null_process_func_t)(struct null_state *state);
+
+/**
+ * @brief Everything the process kernels read that the control plane sets
+ *
+ * The control plane never writes these where the data loop can see
+ * them. null_process_select() builds a complete new config from the
+ * node state and swaps it into null_state.rt on the data loop, between
+ * two cycles, with a blocking spa_loop_invoke(). A kernel therefore
+ * always sees the kernel chain and the format of one configuration,
+ * never a mix of the old and the new one.
+ *
+ * The io areas and the buffer table are part of the config too: once
+ * the swap returns the data loop no longer references the previous
+ * buffers, so use_buffers can only then unmap their memory.
+ */
+struct null_config {
+	null_process_func_t process;       /**< Outermost kernel, called per cycle */
+	null_process_func_t latency_kernel; /**< Wrapped by null_latency_process() */
+	null_process_func_t timing_kernel; /**< Wrapped by null_timing_process() */
+	null_process_func_t shm_kernel;    /**< Wrapped by null_shm_process() */
+	null_process_func_t perf_kernel;   /**< Wrapped by null_perf_process() */
+	uint64_t frame_interval;      /**< Nominal video frame interval (ns) */
+	uint32_t frame_stride;        /**< Bytes per frame, for process_generic */
+	uint32_t media_subtype;       /**< Encoded subtype, for null_encoded_parse() */
+	uint32_t encoded_channels;    /**< Channels, for IEC958 PCM */
+	uint32_t encoded_codec;       /**< SPA_AUDIO_IEC958_CODEC_* for IEC958 */
+	uint32_t format_serial;       /**< Per-format counters reset when it changes */
+	struct spa_process_latency_info latency; /**< Emulated device latency */
+	bool latency_auto;            /**< Feed the auto latency window */
+	bool grouped;                 /**< Slot is swept by the group aggregator */
+	struct spa_io_buffers *io;    /**< Buffer I/O area from graph */
+	struct spa_io_position *position; /**< Graph position and quantum */
+	struct spa_io_clock *clock;   /**< Driver clock, overrides position->clock */
+	uint32_t n_buffers;           /**< Number of valid entries in buffers */
+	struct spa_buffer *buffers[MAX_BUFFERS]; /**< Buffers from use_buffers */
+	void *data[MAX_BUFFERS];      /**< Readable first plane, see null_mem */
+};
+
+/**
+ * @brief Negotiated state saved at ParamBegin
+ *
+ * set_param within a ParamBegin/ParamEnd batch changes the control
+ * fields as usual while the data loop keeps its applied config. When
+ * one of them fails, ParamEnd restores these fields and discards the
+ * batch, so a batch is applied as a whole or not at all.
+ */
+struct null_batch {
+	int res;                      /**< First set_param error, 0 if none */
+	bool have_format;
+	struct spa_audio_info current_format;
+	struct spa_video_info video_format;
+	uint64_t frame_interval;
+	uint32_t frame_stride;
+	uint32_t format_serial;
+	uint32_t encoded_rate;
+	uint32_t encoded_channels;
+	uint32_t encoded_codec;
+	struct spa_process_latency_info process_latency;
+	struct spa_latency_info port_latency[2];
+	struct spa_fraction latency;
+	bool latency_auto;
+};
+
+/**
+ * @brief Readable memory of the first data plane of a buffer
+ *
+ * Set up in use_buffers: MemPtr and host-mapped MemFd data is used as is,
+ * other MemFd data is mapped by the sink itself and unmapped when the
+ * buffers are replaced. DmaBuf data is never mapped (data is NULL).
+ */
+struct null_mem {
+	void *data;                   /**< Start of the data, NULL if unmapped */
+	void *map;                    /**< Own mapping to munmap, or NULL */
+	size_t map_size;              /**< Size of the own mapping */
+};
+
+/*
+ * RT LOG RING:
+ * ===========
+ * Fixed-size diagnostic records pushed from the data loop and formatted
+ * on the main loop (null-rtlog.c).
+ */
+
+/** Number of records in the RT log ring, must be a power of two */
+#define NULL_RTLOG_SIZE 64
+
+/** Events recorded from the data loop */
+enum null_rtlog_event {
+	NULL_RTLOG_INVALID_BUFFER_ID, /**< arg0: buffer id, arg1: n_buffers */
+	NULL_RTLOG_NULL_BUFFER,       /**< arg0: buffer id */
+	NULL_RTLOG_PROGRESS,          /**< arg1: frames, arg2: buffers */
+};
+
+/** One unformatted diagnostic record */
+struct null_rtlog_record {
+	uint64_t time;                /**< Graph or monotonic time (ns) */
+	uint32_t event;               /**< enum null_rtlog_event */
+	uint32_t arg0;
+	uint64_t arg1;
+	uint64_t arg2;
+};
+
+/** Single-producer single-consumer ring of diagnostic records */
+struct null_rtlog {
+	struct spa_ringbuffer ring;
+	uint32_t dropped;             /**< Records lost to a full ring (data loop) */
+	uint32_t reported;            /**< Dropped count already logged (main loop) */
+	int pending;                  /**< A drain is queued on the main loop */
+	struct null_rtlog_record records[NULL_RTLOG_SIZE];
+};
+
+/*
+ * HARDWARE COUNTERS:
+ * =================
+ * perf_event counters around the process kernel (null-perf.c).
+ */
+
+/** Counters: cycles, instructions, cache-misses, branch-misses */
+#define NULL_PERF_COUNTERS 4
+
+/** One per-thread hardware counter and its per-cycle statistics */
+struct null_perf_counter {
+	int fd;                       /**< perf_event fd, -1 when closed */
+	void *page;                   /**< Mapped perf_event_mmap_page, for rdpmc */
+	uint64_t sum;                 /**< Sum of per-cycle deltas */
+	uint64_t min;                 /**< Smallest per-cycle delta */
+	uint64_t max;                 /**< Largest per-cycle delta */
+};
+
+/** Hardware counters measuring the selected process kernel */
+struct null_perf {
+	struct null_perf_counter counters[NULL_PERF_COUNTERS];
+	uint64_t samples;             /**< Measured process cycles */
+	bool open;                    /**< Counters are open */
+};
+
+/*
+ * GRAPH CYCLE TIMING:
+ * ==================
+ * Scheduling latency and driver jitter statistics (null-timing.c).
+ */
+
+/** Histogram buckets: [0,1us) then power-of-two microseconds */
+#define NULL_TIMING_BUCKETS 16
+
+/** Distribution of one timing quantity, in nanoseconds */
+struct null_timing_stat {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint32_t hist[NULL_TIMING_BUCKETS];
+};
+
+/** Graph cycle timing measured in front of the process kernel */
+struct null_timing {
+	struct null_timing_stat latency; /**< Driver wakeup to sink process */
+	struct null_timing_stat jitter;  /**< Wakeup interval deviation from period */
+	uint64_t last_nsec;           /**< Wakeup time of the previous cycle */
+	uint64_t last_period;         /**< Nominal period of the previous cycle (ns) */
+	uint32_t last_id;             /**< Clock id of the previous cycle */
+	uint64_t now;                 /**< Time sampled this cycle, for null_shm_process() */
+};
+
 /*
  * NULL SINK STATE STRUCTURE:
  * ==========================
@@ -126,16 +409,25 @@ extern struct spa_log_topic null_log_topic;
  * SPA OBJECT EMBEDDING PATTERN:
  * =============================
  * SPA objects embed interfaces directly in their state structures:
- * - The spa_node interface is embedded at the beginning
- * - This allows casting between struct null_state* and spa_node*
+ * - The spa_handle is embedded at the beginning, since the factory
+ *   hands out memory of impl_get_size() bytes as a spa_handle
+ * - The spa_node interface is embedded right after it and converted
+ *   with null_state_from_node()
  * - Type safety is maintained through interface versioning
  */
 struct null_state {
+	/*
+	 * EMBEDDED SPA HANDLE:
+	 * ===================
+	 * The spa_handle must be the first member to enable safe casting
+	 * between spa_handle* and null_state* in the factory methods.
+	 */
+	struct spa_handle handle;
+
 	/*
 	 * EMBEDDED SPA NODE INTERFACE:
 	 * ============================
-	 * The spa_node interface must be the first member to enable
-	 * safe casting between null_state* and spa_node*.
+	 * The spa_node interface returned by spa_handle_get_interface().
 	 */
 	struct spa_node node;
 
@@ -150,6 +442,7 @@ struct null_state {
 	struct spa_log *log;           /**< Logging interface */
 	struct spa_system *system;    /**< System interface for timing */
 	struct spa_loop *data_loop;   /**< Data processing event loop */
+	struct spa_loop *main_loop;   /**< Main loop, drains the RT log ring */
 
 	/*
 	 * EVENT CALLBACK MANAGEMENT:
@@ -168,15 +461,22 @@ struct null_state {
 	uint64_t info_all;            /**< Bitmask of available info fields */
 	struct spa_node_info info;   /**< Node information structure */
 	struct spa_param_info params[8]; /**< Supported parameter types */
+	struct spa_dict_item info_items[1]; /**< Node info props */
+	struct spa_dict info_dict;    /**< Dict over info_items */
+	char latency_str[32];         /**< node.latency published in info props */
 
 	/*
 	 * AUDIO FORMAT CONFIGURATION:
 	 * ===========================
 	 * Audio format negotiation is a key part of SPA node operation.
-	 * These fields track the current format configuration.
+	 * These fields track the current format configuration. Video sinks
+	 * use video_format instead of current_format.
 	 */
+	enum null_sink_kind kind;     /**< Media handled by this instance */
 	bool have_format;             /**< True if format has been configured */
 	struct spa_audio_info current_format; /**< Current audio format */
+	struct spa_video_info video_format; /**< Current video format */
+	uint64_t frame_interval;      /**< Nominal video frame interval (ns) */
 
 	/*
 	 * PORT MANAGEMENT:
@@ -196,8 +496,28 @@ struct null_state {
 	 * - Buffer queue management
 	 * - Processing state tracking
 	 */
-	struct spa_io_buffers *io;    /**< Buffer I/O area from graph */
+	struct null_config rt;        /**< Applied config, data loop only */
+	struct null_batch batch;      /**< Saved at ParamBegin, see param_batch */
+	struct spa_io_buffers *io;    /**< Buffer I/O area from graph, see rt.io */
 	struct spa_io_rate_match *rate_match; /**< Rate matching info */
+	struct spa_io_position *position; /**< Graph position and quantum, see rt.position */
+	struct spa_io_clock *clock;   /**< Driver clock, see rt.clock */
+	struct spa_buffer *buffers[MAX_BUFFERS]; /**< Buffers from use_buffers, see rt */
+	struct null_mem mems[MAX_BUFFERS]; /**< Readable memory per buffer */
+	uint32_t n_buffers;           /**< Number of valid entries in buffers */
+	uint32_t frame_stride;        /**< Bytes per frame of current format */
+	uint32_t format_serial;       /**< Bumped by every format change */
+
+	/*
+	 * GROUPED PROCESSING:
+	 * ==================
+	 * Sinks created with the same group key on the same data loop share
+	 * one aggregator. The first raw audio member to run in a cycle
+	 * consumes the io areas of all members in one sweep (see
+	 * null-group.c).
+	 */
+	struct null_group *group;     /**< Aggregator, NULL when not grouped */
+	uint32_t group_slot;          /**< Index in the aggregator tables */
 
 	/*
 	 * TIMING AND SYNCHRONIZATION:
@@ -207,6 +527,19 @@ struct null_state {
 	 */
 	uint64_t quantum_limit;       /**< Maximum processing quantum */
 	struct spa_fraction rate;     /**< Sample rate as fraction */
+	struct spa_fraction latency;  /**< Requested latency, quantum/rate */
+
+	/* Auto latency window (null-props.c), data loop only */
+	uint32_t auto_cycles;         /**< Cycles in the current window */
+	uint32_t auto_peak;           /**< Peak load in the window, permille */
+	int auto_pending;             /**< Change queued to the main loop, atomic */
+
+	/* Emulated device latency (null-latency.c) */
+	struct spa_process_latency_info process_latency; /**< Device latency */
+	struct spa_latency_info port_latency[2]; /**< Port Latency per direction */
+
+	/* Format fixed by the audio.* factory properties */
+	struct spa_audio_info_raw preset_format; /**< Only format enumerated */
 
 	/*
 	 * PROCESSING STATISTICS:
@@ -215,6 +548,43 @@ struct null_state {
 	 */
 	uint64_t frame_count;         /**< Total frames processed (dropped) */
 	uint64_t buffer_count;        /**< Total buffers processed */
+	uint64_t empty_count;         /**< Cycles without new input data */
+	uint64_t byte_count;          /**< Total bytes dropped (video, encoded) */
+	uint64_t last_frame_time;     /**< Time of last video frame (ns) */
+	uint64_t last_interval;       /**< Last video frame interval (ns) */
+	uint64_t jitter_sum;          /**< Sum of frame interval jitter (ns) */
+	uint64_t jitter_max;          /**< Max frame interval jitter (ns) */
+	uint64_t jitter_count;        /**< Number of jitter samples */
+
+	/* Control sinks: events are walked in place, never copied */
+	uint64_t control_events[NULL_CONTROL_TYPES]; /**< Events per SPA_CONTROL_* type */
+	uint64_t midi_events[8];      /**< MIDI messages per status 0x8..0xF */
+	uint64_t offset_sum;          /**< Sum of event offsets (samples) */
+	uint32_t offset_min;          /**< Smallest event offset */
+	uint32_t offset_max;          /**< Largest event offset */
+	uint64_t late_events;         /**< Events at or past the quantum end */
+	uint64_t unordered_events;    /**< Events with decreasing offset */
+	uint64_t bad_sequences;       /**< Buffers without a valid sequence */
+
+	/* Diagnostics from the data loop, never formatted there */
+	struct null_rtlog rtlog;      /**< RT log ring */
+
+	/* Graph scheduling latency and jitter (null.timing) */
+	struct null_timing timing;    /**< Cycle timing statistics */
+
+	/* Counters published for external monitors (null.shm) */
+	struct null_shm_segment *shm; /**< Mapped stats segment, or NULL */
+
+	/* Hardware counters around the process kernel (null.perf) */
+	struct null_perf perf;        /**< perf_event counters */
+
+	/* Encoded audio: frames are counted from their headers only */
+	uint64_t encoded_samples;     /**< Decoded samples represented */
+	uint64_t encoded_payload;     /**< Codec frame bytes, without burst padding */
+	uint32_t encoded_skip;        /**< Bytes of a frame left in the next buffer */
+	uint32_t encoded_rate;        /**< Decoded sample rate (Hz) */
+	uint32_t encoded_channels;    /**< Channels, for IEC958 PCM */
+	uint32_t encoded_codec;       /**< SPA_AUDIO_IEC958_CODEC_* for IEC958 */
 
 	/*
 	 * NODE STATE FLAGS:
@@ -223,6 +593,17 @@ struct null_state {
 	 */
 	unsigned int started:1;       /**< True if node is started */
 	unsigned int following:1;     /**< True if following another node */
+	unsigned int async:1;         /**< True if scheduled as async node */
+	unsigned int stats:1;         /**< True if statistics are collected */
+	unsigned int populate:1;      /**< True to map buffers with MAP_POPULATE */
+	unsigned int mlock:1;         /**< True to lock RT memory on Start */
+	unsigned int locked:1;        /**< True while own RT mappings are locked */
+	unsigned int perf_enabled:1;  /**< True to measure process with perf_event */
+	unsigned int timing_enabled:1; /**< True to measure graph cycle timing */
+	unsigned int preset:1;        /**< True if preset_format is set */
+	unsigned int latency_auto:1;  /**< True to tune latency to the load, see rt */
+	unsigned int param_batch:1;   /**< True between ParamBegin and ParamEnd */
+	unsigned int reconfigure_pending:1; /**< Batched change awaiting ParamEnd */
 };
 
 /*
@@ -284,6 +665,518 @@ int null_state_init(struct null_state *state,
  */
 void null_state_cleanup(struct null_state *state);
 
+/*
+ * PROCESS KERNELS (null-process.c):
+ * =================================
+ */
+
+/**
+ * @brief Size in bytes of one sample of a raw audio format
+ *
+ * @param format SPA_AUDIO_FORMAT_* value
+ * @return Sample size, or 0 for unknown formats
+ */
+uint32_t null_audio_sample_size(uint32_t format);
+
+/**
+ * @brief Bytes per frame of the first data plane of a raw audio format
+ *
+ * For interleaved formats this covers all channels, for planar formats
+ * one sample of the first channel.
+ *
+ * @param raw Raw audio format
+ * @return Frame stride, or 0 for unknown formats
+ */
+uint32_t null_audio_frame_stride(const struct spa_audio_info_raw *raw);
+
+/** Most channels a raw audio format may have */
+#define NULL_AUDIO_MAX_CHANNELS	64
+/** Highest sample rate a raw audio format may have */
+#define NULL_AUDIO_MAX_RATE	192000
+
+/**
+ * @brief Check a raw audio format against the bounds of the null nodes
+ *
+ * Shared by the sink and the loopback, so both accept the same formats.
+ * Errors are logged as "<name> <obj>: ...".
+ *
+ * @param log Log to report a rejected format to
+ * @param name Log prefix of the node, e.g. "null-sink"
+ * @param obj Node pointer for the log prefix
+ * @param raw Raw audio format to check
+ * @return 0 if channels, rate and sample format are supported, -EINVAL if not
+ */
+int null_audio_check_raw(struct spa_log *log, const char *name, const void *obj,
+                         const struct spa_audio_info_raw *raw);
+
+/**
+ * @brief Select the process kernel for the current configuration
+ *
+ * Must be called after every change of started, have_format, the format,
+ * the group or the enabled features.
+ *
+ * @param state Null sink state
+ */
+void null_process_select(struct null_state *state);
+
+/**
+ * @brief Publish the io areas and buffer table to the data loop
+ *
+ * Swaps only the buffers and their readable memory into rt, keeping the
+ * applied kernel chain, and drops the buffer, position and clock areas
+ * that were removed.
+ * Returns once the data loop uses the new table, so memory of the
+ * previous buffers can be released afterwards.
+ *
+ * @param state Null sink state
+ */
+void null_process_set_buffers(struct null_state *state);
+
+/*
+ * RT LOG RING (null-rtlog.c):
+ * ===========================
+ */
+
+/**
+ * @brief Record a diagnostic event from the data loop
+ *
+ * Lock-free and without formatting. The record is dropped and counted
+ * when the ring is full.
+ *
+ * @param state Null sink state
+ * @param event enum null_rtlog_event
+ */
+void null_rtlog_push(struct null_state *state, uint32_t event,
+                     uint32_t arg0, uint64_t arg1, uint64_t arg2);
+
+/**
+ * @brief Format and log all pending records (main loop)
+ *
+ * @param state Null sink state
+ */
+void null_rtlog_drain(struct null_state *state);
+
+/**
+ * @brief Wait for a queued drain and drain the remaining records
+ *
+ * Must be called before the state is freed.
+ *
+ * @param state Null sink state
+ */
+void null_rtlog_flush(struct null_state *state);
+
+/*
+ * LATENCY REPORTING (null-latency.c):
+ * ===================================
+ */
+
+/**
+ * @brief Reset process and port latency to zero
+ */
+void null_latency_init(struct null_state *state);
+
+/**
+ * @brief Set the emulated device latency
+ *
+ * Updates the input port Latency. The clock delay follows once the
+ * config is reselected.
+ */
+void null_latency_set_process(struct null_state *state,
+                              const struct spa_process_latency_info *info);
+
+/**
+ * @brief Build a Latency or ProcessLatency param for enumeration
+ *
+ * @param port  True for port params, which include Latency per direction
+ *
+ * @return 1 if a param was built, 0 when @p index is past the last one
+ */
+int null_latency_enum_param(struct null_state *state, uint32_t id, uint32_t index,
+                            bool port, struct spa_pod_builder *b, struct spa_pod **param);
+
+/**
+ * @brief Apply a Latency or ProcessLatency param
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int null_latency_set_param(struct null_state *state, uint32_t id,
+                           const struct spa_pod *param);
+
+/**
+ * @brief True when @p l adds any latency
+ */
+bool null_latency_active(const struct spa_process_latency_info *l);
+
+/**
+ * @brief Process kernel reporting rt.latency as clock delay before rt.latency_kernel
+ *
+ * Installed by null_process_select() while a process latency is set
+ * and clock and position are available. The delay is only written
+ * while the node drives the graph, which a null sink only does when the
+ * host makes it the driver; as a follower it writes nothing.
+ */
+int null_latency_process(struct null_state *state);
+
+/**
+ * @brief Emit node info with the pending change_mask
+ *
+ * @param state Null sink state
+ * @param full  True to emit all fields, for a new listener
+ */
+void null_emit_node_info(struct null_state *state, bool full);
+
+/*
+ * RUNTIME PROPS (null-props.c):
+ * =============================
+ */
+
+/**
+ * @brief Publish the requested latency as node.latency in the info props
+ *
+ * Marks the props as changed, the caller emits the info.
+ */
+void null_props_update_info(struct null_state *state);
+
+/**
+ * @brief Build a PropInfo or Props param for enumeration
+ *
+ * @return 1 if a param was built, 0 when @p index is past the last one
+ */
+int null_props_enum(struct null_state *state, uint32_t id, uint32_t index,
+                    struct spa_pod_builder *b, struct spa_pod **param);
+
+/**
+ * @brief Apply a Props param, emitting node info on changes
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int null_props_set(struct null_state *state, const struct spa_pod *param);
+
+/**
+ * @brief Feed one cycle's scheduling latency to the auto latency window
+ *
+ * Called from null_timing_process() in the data loop while
+ * rt.latency_auto is set.
+ */
+void null_props_auto_sample(struct null_state *state, const struct spa_io_clock *clock,
+                            uint64_t latency_ns, uint64_t period_ns);
+
+/*
+ * GRAPH CYCLE TIMING (null-timing.c):
+ * ===================================
+ */
+
+/**
+ * @brief Process kernel sampling the graph clock before rt.timing_kernel
+ *
+ * Installed by null_process_select() while a clock is available.
+ */
+int null_timing_process(struct null_state *state);
+
+/**
+ * @brief Clear the timing statistics
+ *
+ * @param state Null sink state
+ */
+void null_timing_reset(struct null_state *state);
+
+/**
+ * @brief Log latency and jitter min/avg/max and histograms
+ *
+ * @param state Null sink state
+ */
+void null_timing_log(struct null_state *state);
+
+/*
+ * SHARED-MEMORY STATS (null-shm.c):
+ * =================================
+ */
+
+/**
+ * @brief Create and map the stats segment for this sink
+ *
+ * @param state Null sink state
+ * @param name  Node name for the segment name, NULL for a unique default
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int null_shm_open(struct null_state *state, const char *name);
+
+/**
+ * @brief Unmap and unlink the stats segment
+ *
+ * @param state Null sink state, may or may not have a segment
+ */
+void null_shm_close(struct null_state *state);
+
+/**
+ * @brief Process kernel publishing the counters after rt.shm_kernel
+ *
+ * Installed by null_process_select() while a segment is mapped.
+ */
+int null_shm_process(struct null_state *state);
+
+/**
+ * @brief Publish the final counters with started cleared (data loop)
+ *
+ * @param state Null sink state, may or may not have a segment
+ */
+void null_shm_stopped(struct null_state *state);
+
+/*
+ * HARDWARE COUNTERS (null-perf.c):
+ * ================================
+ */
+
+/**
+ * @brief Open the hardware counters on the data loop thread
+ *
+ * @param state Null sink state
+ *
+ * @return 0 on success, negative error code when perf_event is unavailable
+ */
+int null_perf_open(struct null_state *state);
+
+/**
+ * @brief Close the hardware counters
+ *
+ * @param state Null sink state, counters may or may not be open
+ */
+void null_perf_close(struct null_state *state);
+
+/**
+ * @brief Process kernel measuring rt.perf_kernel with the hardware counters
+ *
+ * Installed by null_process_select() while the counters are open.
+ */
+int null_perf_process(struct null_state *state);
+
+/**
+ * @brief Log the counter totals, IPC and per-cycle ranges
+ *
+ * @param state Null sink state
+ */
+void null_perf_log(struct null_state *state);
+
+/*
+ * RT MEMORY RESIDENCY (null-memory.c):
+ * ====================================
+ */
+
+/**
+ * @brief Prefault the state and buffer memory, lock the sink's own mappings
+ *
+ * Called on Start when the null.mlock property is set. Pages are
+ * prefaulted even when mlock() is not permitted. locked is only set
+ * when every own mapping could be locked.
+ *
+ * @param state Null sink state
+ *
+ * @return 0 on success, negative error code when locking failed
+ */
+int null_memory_lock(struct null_state *state);
+
+/**
+ * @brief Unlock the own mappings locked by null_memory_lock()
+ *
+ * Memory of the host is never unlocked.
+ *
+ * @param state Null sink state, may or may not be locked
+ */
+void null_memory_unlock(struct null_state *state);
+
+/**
+ * @brief Lock the buffers mapped by the sink, prefault the host's
+ *
+ * @return 0 on success, negative error code when locking failed
+ */
+int null_memory_lock_buffers(struct null_state *state);
+
+/*
+ * VIDEO FORMATS (null-video.c):
+ * =============================
+ */
+
+/**
+ * @brief Build the video format with @p index for enumeration
+ *
+ * @param state Null sink state
+ * @param id    Parameter id of the built object
+ * @param index Format index, 0 is DMA-BUF, 1 is shared memory
+ * @param b     Builder for the format
+ * @param param Output for the built format
+ *
+ * @return 1 if a format was built, 0 when @p index is past the last one
+ */
+int null_video_enum_format(struct null_state *state, uint32_t id, uint32_t index,
+                           struct spa_pod_builder *b, struct spa_pod **param);
+
+/**
+ * @brief Build the negotiated video format, for the port Format param
+ *
+ * @return 1 if a format was built, 0 on failure
+ */
+int null_video_build_format(struct null_state *state, uint32_t id,
+                            struct spa_pod_builder *b, struct spa_pod **param);
+
+/**
+ * @brief Parse and validate a video/raw format
+ *
+ * @param state Null sink state, for logging
+ * @param param Format parameter
+ * @param info  Output for the parsed format
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int null_video_parse_format(struct null_state *state, const struct spa_pod *param,
+                            struct spa_video_info *info);
+
+/**
+ * @brief Nominal frame interval of a video format
+ *
+ * @return Interval in nanoseconds, or 0 for variable framerate
+ */
+uint64_t null_video_frame_interval(const struct spa_video_info *info);
+
+/*
+ * CONTROL FORMATS (null-control.c):
+ * =================================
+ */
+
+/**
+ * @brief Build the application/control format for enumeration
+ *
+ * @return 1 if a format was built, 0 when @p index is past the last one
+ */
+int null_control_enum_format(struct null_state *state, uint32_t id, uint32_t index,
+                             struct spa_pod_builder *b, struct spa_pod **param);
+
+/**
+ * @brief Validate an application/control format
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int null_control_parse_format(struct null_state *state, const struct spa_pod *param);
+
+/*
+ * ENCODED AUDIO (null-encoded.c):
+ * ===============================
+ */
+
+/**
+ * @brief Build the encoded audio format with @p index for enumeration
+ *
+ * Formats are IEC958, AAC, MP3 and Opus, in that order.
+ *
+ * @return 1 if a format was built, 0 when @p index is past the last one
+ */
+int null_encoded_enum_format(struct null_state *state, uint32_t id, uint32_t index,
+                             struct spa_pod_builder *b, struct spa_pod **param);
+
+/**
+ * @brief Build the negotiated encoded format, for the port Format param
+ *
+ * @return 1 when a format was built
+ */
+int null_encoded_build_format(struct null_state *state, uint32_t id,
+                              struct spa_pod_builder *b, struct spa_pod **param);
+
+/**
+ * @brief Validate an encoded audio format and store its framing parameters
+ *
+ * @param state Null sink state
+ * @param param Format parameter
+ * @param info  Media type and subtype, already parsed from @p param
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int null_encoded_parse_format(struct null_state *state, const struct spa_pod *param,
+                              struct spa_audio_info *info);
+
+/**
+ * @brief Count the encoded frames in one buffer (real-time safe)
+ *
+ * @param state Null sink state with an encoded format
+ * @param data  Start of the valid chunk data
+ * @param size  Size of the valid chunk data
+ *
+ * @return Number of frames, bursts or packets found
+ */
+uint32_t null_encoded_parse(struct null_state *state, const uint8_t *data, uint32_t size);
+
+/**
+ * @brief Average bitrate of the encoded stream so far
+ *
+ * @return Bits per second, or 0 before any samples were counted
+ */
+uint64_t null_encoded_bitrate(struct null_state *state);
+
+/*
+ * GROUPED PROCESSING (null-group.c):
+ * ==================================
+ * Many null sinks on one data loop each get a separate process() call
+ * with their own cache misses. Grouped sinks instead register with a
+ * shared aggregator that keeps the per-member RT state in a
+ * structure-of-arrays table and consumes every ready member's
+ * spa_io_buffers in a single linear sweep.
+ */
+
+/**
+ * @brief Register a null sink with the aggregator for @p key
+ *
+ * The aggregator is created on first use and shared by all sinks that
+ * join with the same key on the same data loop.
+ *
+ * @param state Null sink state, must not be in a group yet
+ * @param key   Group key, usually from the "null.group" property
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int null_group_join(struct null_state *state, const char *key);
+
+/**
+ * @brief Remove a null sink from its aggregator
+ *
+ * The member's counters are copied back into @p state. The aggregator
+ * is destroyed when its last member leaves.
+ *
+ * @param state Null sink state, may or may not be in a group
+ */
+void null_group_leave(struct null_state *state);
+
+/**
+ * @brief Refresh the member's slot from the applied config
+ *
+ * Called on the data loop whenever a new config is swapped into rt. The
+ * slot is only swept while rt.grouped is set.
+ *
+ * @param state Null sink state, may or may not be in a group
+ */
+void null_group_apply(struct null_state *state);
+
+/**
+ * @brief Process entry point for grouped sinks
+ *
+ * Runs the sweep over all members if this member has new data, otherwise
+ * the member was already consumed by an earlier sweep in this cycle.
+ *
+ * @param state Null sink state in a group
+ *
+ * @return SPA_STATUS_HAVE_DATA if this member's buffer was consumed
+ * @return SPA_STATUS_NEED_DATA otherwise
+ */
+int null_group_process(struct null_state *state);
+
+/**
+ * @brief Read the member's counters from the aggregator table
+ *
+ * @param state   Null sink state in a group
+ * @param frames  Output for frames dropped by this member
+ * @param buffers Output for buffers dropped by this member
+ */
+void null_group_get_stats(struct null_state *state,
+                          uint64_t *frames, uint64_t *buffers);
+
 /*
  * SPA INTERFACE CONVERSION MACROS:
  * ===============================
@@ -303,6 +1196,22 @@ void null_state_cleanup(struct null_state *state);
 #define null_state_from_node(node) \
 	spa_container_of((node), struct null_state, node)
 
+/**
+ * @brief Current monotonic time in nanoseconds
+ *
+ * Uses the host's spa_system so it is safe to call from the data loop.
+ *
+ * @param state Null sink state
+ * @return Monotonic time in nanoseconds
+ */
+static inline uint64_t null_get_time(struct null_state *state)
+{
+	struct timespec now;
+
+	spa_system_clock_gettime(state->system, CLOCK_MONOTONIC, &now);
+	return SPA_TIMESPEC_TO_NSEC(&now);
+}
+
 /*
  * PLUGIN FACTORY DECLARATIONS:
  * ============================
@@ -314,6 +1223,18 @@ void null_state_cleanup(struct null_state *state);
 /** Null sink factory - creates null audio sink nodes */
 extern const struct spa_handle_factory spa_null_sink_factory;
 
+/** Null video sink factory - creates null video sink nodes */
+extern const struct spa_handle_factory spa_null_video_sink_factory;
+
+/** Null control sink factory - creates null MIDI/control sink nodes */
+extern const struct spa_handle_factory spa_null_control_sink_factory;
+
+/** Null loopback factory - null sink republishing audio one quantum later */
+extern const struct spa_handle_factory spa_null_loopback_factory;
+
+/** Null mix sink factory - sums dynamic inputs into one accumulator */
+extern const struct spa_handle_factory spa_null_mix_sink_factory;
+
 #ifdef __cplusplus
 }
 #endif